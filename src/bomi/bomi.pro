@@ -259,6 +259,13 @@ HEADERS += \
     os/os.hpp \
     os/x11.hpp \
     enum/codecid.hpp \
+    subtitle/subtitleautoloader.hpp \
+    subtitle/subtitlecache.hpp \
+    misc/runnable.hpp \
+    misc/urlresolver.hpp \
+    player/historywriter.hpp \
+    misc/startuptrace.hpp \
+    video/frametimingrecorder.hpp \
     global.hpp \
     global_def.hpp
 
@@ -447,6 +454,12 @@ SOURCES += \
     os/x11.cpp \
     os/os.cpp \
     enum/codecid.cpp \
+    subtitle/subtitleautoloader.cpp \
+    subtitle/subtitlecache.cpp \
+    misc/urlresolver.cpp \
+    player/historywriter.cpp \
+    misc/startuptrace.cpp \
+    video/frametimingrecorder.cpp \
     global.cpp
 
 TRANSLATIONS += translations/bomi_ko.ts \
@@ -504,6 +517,7 @@ OTHER_FILES += \
 	imports/bomi/PlayInfoAudioOutput.qml \
 	imports/bomi/PlayInfoTrack.qml \
 	imports/bomi/PlayInfoSubtitleList.qml \
+	imports/bomi/PlayInfoFrameTiming.qml \
 	skins/one/bomi.qml
 
 evil_hack_to_fool_lupdate {
@@ -0,0 +1,39 @@
+import QtQuick 2.0
+
+Column {
+    id: item
+    property var timing
+    readonly property real fontSize: parent.fontSize
+    PlayInfoText {
+        text: qsTr("Frame Interval: %1ms(±%2ms) Late: %3")
+            .arg(formatNumberNA(timing.interval, 2))
+            .arg(formatNumberNA(timing.jitter, 2)).arg(timing.late)
+    }
+    PlayInfoText {
+        text: qsTr("Render Time: CPU %1ms GPU %2ms Latency: %3ms")
+            .arg(formatNumberNA(timing.render, 2))
+            .arg(formatNumberNA(timing.gpu, 2))
+            .arg(formatNumberNA(timing.latency, 1))
+    }
+    // swap intervals in 1ms bins; last bin counts all longer intervals
+    Canvas {
+        id: histogram
+        width: item.fontSize*20; height: item.fontSize*3
+        visible: timing.histogram.length > 0
+        onPaint: {
+            var ctx = getContext("2d")
+            var bins = timing.histogram
+            ctx.clearRect(0, 0, width, height)
+            var max = 1
+            for (var i = 0; i < bins.length; ++i)
+                max = Math.max(max, bins[i])
+            var w = width/bins.length
+            ctx.fillStyle = "yellow"
+            for (i = 0; i < bins.length; ++i) {
+                var h = height*bins[i]/max
+                ctx.fillRect(i*w, height - h, Math.max(1, w - 1), h)
+            }
+        }
+        Connections { target: timing; onChanged: histogram.requestPaint() }
+    }
+}
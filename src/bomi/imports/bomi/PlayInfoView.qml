@@ -60,6 +60,14 @@ Item {
                            : qsTr("%1KiB(%3% of %2KiB)").arg(used).arg(size)
                                 .arg(percent.toFixed(1)))
         }
+        PlayInfoText {
+            readonly property var cache: engine.cache
+            visible: engine.cacheSize > 0
+            text: qsTr("Cache I/O: in %1KiB/s out %2KiB/s, Seeks: %3/%4 cached, Underruns: %5")
+                .arg((cache.inRate/1024).toFixed(0)).arg((cache.outRate/1024).toFixed(0))
+                .arg(cache.seeksCached).arg(cache.seeksCached + cache.seeksMissed)
+                .arg(cache.underruns)
+        }
 
         PlayInfoText { }
 
@@ -83,6 +91,12 @@ Item {
         PlayInfoText {
             text: qsTr("Delayed Frames: %1 (%2ms)").arg(video.delayedFrames).arg(video.delayedTime);
         }
+        PlayInfoText {
+            text: qsTr("Frame Queue: depth %1, dropped %2 late/%3 full")
+                .arg(video.frameQueueDepth).arg(video.lateDroppedFrames)
+                .arg(video.queueDroppedFrames);
+        }
+        PlayInfoFrameTiming { timing: video.timing }
 
         PlayInfoText {
             readonly property var hw: video.hwacc
@@ -8,6 +8,30 @@
 static const auto jio = JIO(JE(enabled), JE(mode), JE(search_paths));
 JSON_DECLARE_FROM_TO_FUNCTIONS
 
+// listings are validated by modification time of directory
+static auto entries(const QDir &dir, const QStringList &filter,
+                    QDir::Filters filters) -> QFileInfoList
+{
+    struct Entry { QDateTime modified; QFileInfoList list; };
+    static QMutex mutex;
+    static QHash<QString, Entry> cache;
+    const auto path = dir.absolutePath();
+    const auto modified = QFileInfo(path).lastModified();
+    const auto key = path % '|'_q % QString::number(int(filters))
+            % '|'_q % filter.join(';'_q);
+    QMutexLocker locker(&mutex);
+    auto it = cache.find(key);
+    if (it != cache.end() && it->modified == modified)
+        return it->list;
+    locker.unlock();
+    const auto list = dir.entryInfoList(filter, filters, QDir::Name);
+    locker.relock();
+    if (cache.size() > 256)
+        cache.clear();
+    cache.insert(key, { modified, list });
+    return list;
+}
+
 auto Autoloader::autoload(const Mrl &mrl, ExtType type) const -> QStringList
 {
     if (!mrl.isLocalFile() || !enabled)
@@ -15,9 +39,10 @@ auto Autoloader::autoload(const Mrl &mrl, ExtType type) const -> QStringList
     const QFileInfo fileInfo(mrl.toLocalFile());
     auto root = fileInfo.dir();
     auto loaded = tryDir(fileInfo, type, root);
-    auto list = root.entryList(QDir::Dirs | QDir::NoDotAndDotDot, QDir::Name);
+    const auto dirs = entries(root, {}, QDir::Dirs | QDir::NoDotAndDotDot);
     for (auto &path : search_paths) {
-        for (auto &one : list) {
+        for (auto &info : dirs) {
+            const auto one = info.fileName();
             if (path.match(one)) {
                 auto dir = root;
                 if (dir.cd(one))
@@ -36,7 +61,7 @@ auto Autoloader::tryDir(const QFileInfo &fileInfo, ExtType type,
         return QStringList();
     QStringList files;
     const auto filter = _ToNameFilter(type);
-    const auto all = dir.entryInfoList(filter, QDir::Files, QDir::Name);
+    const auto all = entries(dir, filter, QDir::Files);
     const auto base = fileInfo.completeBaseName();
     for (int i = 0; i < all.size(); ++i) {
         if (all[i].fileName() == fileInfo.fileName())
@@ -4,6 +4,7 @@
 #include "configure.hpp"
 #include "tmp/algorithm.hpp"
 #include <cstdlib>
+#include <atomic>
 
 #if HAVE_SYSTEMD
 #include <syslog.h>
@@ -27,42 +28,244 @@ static Log::Level lvFile    = Log::Off;
 static Log::Level lvViewer  = Log::Off;
 static Log::Level lvMax     = Log::Trace;
 
-static QReadWriteLock s_rwLock;
-static QHash<QObject*, int> s_subscribers;
-
-static QSharedPointer<FILE> s_file;
-
 const QStringList Log::m_options = QStringList()
         << u"off"_q   << u"fatal"_q << u"error"_q << u"warn"_q
         << u"info"_q  << u"debug"_q << u"trace"_q;
 
-SIA print(FILE *file, const QByteArray &log) -> void
+struct QueuedLog {
+    // for order between threads; taken before the message is queued, so it
+    // orders messages drained in the same batch only
+    quint64 seq = 0;
+    LogMessage msg;
+};
+
+// wait-free queue for one producer thread and the writer
+class LogQueue {
+public:
+    static constexpr int Capacity = 2048;
+    LogQueue(): m_slots(Capacity) { }
+    auto push(QueuedLog &&log) -> bool
+    {
+        const int tail = m_tail.load(std::memory_order_relaxed);
+        const int next = (tail + 1) % Capacity;
+        if (next == m_head.load(std::memory_order_acquire))
+            return false;
+        m_slots[tail] = std::move(log);
+        m_tail.store(next, std::memory_order_release);
+        return true;
+    }
+    auto pop(QueuedLog &log) -> bool
+    {
+        const int head = m_head.load(std::memory_order_relaxed);
+        if (head == m_tail.load(std::memory_order_acquire))
+            return false;
+        log = std::move(m_slots[head]);
+        m_slots[head] = QueuedLog();
+        m_head.store((head + 1) % Capacity, std::memory_order_release);
+        return true;
+    }
+    std::atomic<bool> closed{false}; // producer thread has finished
+private:
+    QVector<QueuedLog> m_slots;
+    std::atomic<int> m_head{0}, m_tail{0};
+};
+
+// Writes messages from all threads in batches on its own thread so that
+// logging never waits for I/O. Messages are dropped if a queue is full.
+// Messages of different threads are in order within a batch but one queued
+// late may be written after a later message of another thread.
+class LogWriter : public QThread {
+public:
+    auto start() -> void
+    {
+        QMutexLocker locker(&m_mutex);
+        if (m_running)
+            return;
+        m_running = true;
+        m_quit = false;
+        QThread::start(QThread::LowPriority);
+        qAddPostRoutine(finalize);
+    }
+    // logs after this are written synchronously
+    static auto finalize() -> void;
+    auto stop() -> void
+    {
+        // push() writes synchronously from now; final flush() drains the rest
+        m_running = false;
+        m_mutex.lock();
+        m_quit = true;
+        m_wake.wakeAll();
+        m_mutex.unlock();
+        if (isRunning())
+            wait();
+        flush();
+    }
+    auto push(Log::Level lv, const QByteArray &text) -> void
+    {
+        if (!m_running) {
+            QMutexLocker locker(&m_drain);
+            write({ { m_seq++, { lv, text } } });
+            return;
+        }
+        if (!local()->push({ m_seq++, { lv, text } })) {
+            ++m_dropped;
+            return;
+        }
+        if (++m_pending > LogQueue::Capacity / 2)
+            m_wake.wakeOne();
+    }
+    // drains queues in caller thread
+    auto flush() -> void
+    {
+        QMutexLocker locker(&m_drain);
+        drain();
+    }
+    auto subscribe(QObject *o, int event) -> void
+    {
+        QMutexLocker locker(&m_drain);
+        m_subscribers.insert(o, event);
+    }
+    auto unsubscribe(QObject *o) -> void
+    {
+        QMutexLocker locker(&m_drain);
+        m_subscribers.remove(o);
+    }
+    auto dropped() const -> quint64 { return m_dropped; }
+    auto setFile(FILE *file) -> void
+    {
+        QMutexLocker locker(&m_drain);
+        m_file = QSharedPointer<FILE>(file, fclose);
+    }
+private:
+    struct LocalQueue {
+        QSharedPointer<LogQueue> queue;
+        ~LocalQueue() { if (queue) queue->closed = true; }
+    };
+    auto local() -> LogQueue*
+    {
+        static thread_local LocalQueue local;
+        if (!local.queue) {
+            local.queue = QSharedPointer<LogQueue>::create();
+            QMutexLocker locker(&m_mutex);
+            m_queues.push_back(local.queue);
+        }
+        return local.queue.data();
+    }
+    auto run() -> void override
+    {
+        QMutexLocker locker(&m_mutex);
+        while (!m_quit) {
+            m_wake.wait(&m_mutex, 50);
+            locker.unlock();
+            flush();
+            locker.relock();
+        }
+    }
+    // called with m_drain locked
+    auto drain() -> void
+    {
+        QVector<QSharedPointer<LogQueue>> queues;
+        m_mutex.lock();
+        queues = m_queues;
+        m_mutex.unlock();
+
+        QVector<QueuedLog> batch;
+        QueuedLog log;
+        QVector<QSharedPointer<LogQueue>> closed;
+        for (auto &q : queues) {
+            const bool done = q->closed;
+            while (q->pop(log))
+                batch.push_back(std::move(log));
+            if (done)
+                closed.push_back(q);
+        }
+        if (!closed.isEmpty()) {
+            QMutexLocker locker(&m_mutex);
+            for (auto &q : closed)
+                m_queues.removeOne(q);
+        }
+        m_pending -= batch.size();
+        const quint64 dropped = m_dropped;
+        if (dropped != m_reported) {
+            auto text = Log::parse(Log::Warn, "Log", "%% message(s) dropped",
+                                   dropped - m_reported);
+            batch.push_back({ m_seq++, { Log::Warn, text += '\n' } });
+            m_reported = dropped;
+        }
+        if (batch.isEmpty())
+            return;
+        std::sort(batch.begin(), batch.end(), [] (auto &lhs, auto &rhs)
+            { return lhs.seq < rhs.seq; });
+        write(batch);
+    }
+    auto write(const QVector<QueuedLog> &batch) -> void
+    {
+        bool out = false, err = false, file = false;
+        QVector<LogMessage> viewer;
+        for (auto &log : batch) {
+            const auto lv = log.msg.level;
+            auto &text = log.msg.text;
+#if HAVE_SYSTEMD
+            if (lv <= lvJournal)
+                sd_journal_print(jp[lv], "%s", text.constData());
+#endif
+            if (lv <= lvStdOut) {
+                fwrite(text.constData(), 1, text.size(), stdout);
+                out = true;
+            }
+            if (lv <= lvStdErr) {
+                fwrite(text.constData(), 1, text.size(), stderr);
+                err = true;
+            }
+            if (lv <= lvFile && m_file) {
+                fwrite(text.constData(), 1, text.size(), m_file.data());
+                file = true;
+            }
+            if (lv <= lvViewer && !m_subscribers.isEmpty())
+                viewer.push_back(log.msg);
+        }
+        if (out)
+            fflush(stdout);
+        if (err)
+            fflush(stderr);
+        if (file)
+            fflush(m_file.data());
+        if (!viewer.isEmpty() && qApp) {
+            for (auto it = m_subscribers.cbegin(); it != m_subscribers.cend(); ++it)
+                _PostEvent(it.key(), it.value(), viewer);
+        }
+    }
+
+    QMutex m_mutex;  // guards m_queues, m_quit
+    QWaitCondition m_wake;
+    QVector<QSharedPointer<LogQueue>> m_queues;
+    bool m_quit = false;
+    std::atomic<bool> m_running{false};
+
+    QMutex m_drain;  // held while writing; below are guarded by this
+    QHash<QObject*, int> m_subscribers;
+    QSharedPointer<FILE> m_file;
+    quint64 m_reported = 0;
+
+    std::atomic<quint64> m_seq{0}, m_dropped{0};
+    std::atomic<int> m_pending{0};
+};
+
+// never deleted to be available until the end of process
+static LogWriter *s_writer = new LogWriter;
+
+auto LogWriter::finalize() -> void
 {
-    fwrite(log.constData(), 1, log.size(), file);
-    fflush(file);
+    s_writer->stop();
 }
 
 auto Log::print(Level lv, const QByteArray &log) -> void
 {
-#if HAVE_SYSTEMD
-    if (lv <= lvJournal)
-        sd_journal_print(jp[lv], log.constData());
-#endif
-    if (lv <= lvStdOut)
-        ::print(stdout, log);
-    if (lv <= lvStdErr)
-        ::print(stderr, log);
-    if (lv <= lvFile && s_file)
-        ::print(s_file.data(), log);
-    if (lv <= lvViewer && !s_subscribers.isEmpty()) {
-        s_rwLock.lockForRead();
-        auto &s = _C(s_subscribers);
-        for (auto it = s.begin(); it != s.end(); ++it)
-            _PostEvent(it.key(), it.value(), lv, log);
-        s_rwLock.unlock();
-    }
-    if (lv == Fatal)
+    s_writer->push(lv, log);
+    if (lv == Fatal) {
+        s_writer->flush();
         abort();
+    }
 }
 
 static const std::array<Log::Level, 4> lvQt = []() {
@@ -95,6 +298,7 @@ auto Log::setOption(const LogOption &option) -> void
     lvMax = tmp::max(lvMax, lvJournal);
 #endif
 
+    s_writer->start();
     if (!lvFile)
         return;
     auto path = option.file().toLocal8Bit();
@@ -103,7 +307,7 @@ auto Log::setOption(const LogOption &option) -> void
         qDebug("Cannot open file: %s\n", path.constData());
         return;
     }
-    s_file = QSharedPointer<FILE>(pf, fclose);
+    s_writer->setFile(pf);
 }
 
 auto Log::option() -> const LogOption&
@@ -118,16 +322,23 @@ auto Log::maximumLevel() -> Level
 
 auto Log::subscribe(QObject *o, int event) -> int
 {
-    QWriteLocker l(&s_rwLock);
-    s_subscribers.insert(o, event);
+    s_writer->subscribe(o, event);
     return s_option.lines() ? s_option.lines() : _Max<int>();
 }
 
 auto Log::unsubscribe(QObject *o) -> void
 {
-    s_rwLock.lockForWrite();
-    s_subscribers.remove(o);
-    s_rwLock.unlock();
+    s_writer->unsubscribe(o);
+}
+
+auto Log::flush() -> void
+{
+    s_writer->flush();
+}
+
+auto Log::dropped() -> quint64
+{
+    return s_writer->dropped();
 }
 
 auto _ToLog(const QVariant &var) -> QByteArray
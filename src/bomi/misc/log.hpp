@@ -87,8 +87,13 @@ public:
     static auto setOption(const LogOption &option) -> void;
     static auto option() -> const LogOption&;
     static auto qt(QtMsgType type, const QMessageLogContext &context, const QString &msg) -> void;
+    // subscriber receives QVector<LogMessage> as DataEvent of given type
     static auto subscribe(QObject *o, int event) -> int;
     static auto unsubscribe(QObject *o) -> void;
+    // writes all queued messages before return
+    static auto flush() -> void;
+    // count of messages dropped because writer could not catch up
+    static auto dropped() -> quint64;
 private:
     struct Helper {
         template<class... Args>
@@ -146,6 +151,11 @@ private:
     static const QStringList m_options;
 };
 
+struct LogMessage {
+    Log::Level level = Log::Off;
+    QByteArray text; // formatted and terminated by new line
+};
+
 #define DECLARE_LOG_CONTEXT(ctx) \
     static inline const char *getLogContext() { return (#ctx); }
 
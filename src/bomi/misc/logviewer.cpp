@@ -1,23 +1,40 @@
 #include "logviewer.hpp"
 #include "logoption.hpp"
 #include "dataevent.hpp"
-#include "simplelistmodel.hpp"
+#include "runnable.hpp"
 #include "log.hpp"
 #include "dialog/mbox.hpp"
 #include "ui_logviewer.h"
 #include <QMenu>
 #include <QClipboard>
-#include <set>
+#include <QThreadPool>
 
 static const int LogEvent = QEvent::User + 10;
+static const int FilterEvent = QEvent::User + 11;
+static const int DefaultLines = 50000;
 
 struct LogEntry {
     Log::Level level = Log::Off;
-    QString context, message;
+    int context = -1;
+    QString message;
 };
 
-class LogEntryModel : public SimpleListModel<LogEntry>
-{
+// level and context of entry kept apart from message to be shared cheaply
+struct LogKey {
+    Log::Level level = Log::Off;
+    int context = -1;
+};
+
+struct LogFilter {
+    std::array<bool, Log::Trace + 1> level;
+    QVector<bool> context; // indexed by context id
+    auto accepts(const LogKey &key) const -> bool
+        { return level[key.level] && context.value(key.context); }
+};
+
+// Keeps last entries in a fixed-size ring buffer and exposes only the ones
+// accepted by filter. Entries are identified by sequence number.
+class LogEntryModel : public QAbstractListModel {
 public:
     LogEntryModel()
     {
@@ -29,46 +46,117 @@ public:
         m_fgs[Log::Debug] = Qt::green;
         m_fgs[Log::Trace] = Qt::gray;
     }
-
-    auto displayData(int row, int /*column*/) const -> QVariant final
-        { return at(row).message; }
-    auto fontData(int /*row*/, int /*column*/) const -> QFont final
-        { return m_mono; }
-    auto roleData(int row, int /*column*/, int role) const -> QVariant final
+    auto setCapacity(int capacity) -> void
+    {
+        beginResetModel();
+        m_entries.clear();
+        m_entries.resize(capacity);
+        m_keys.clear();
+        m_keys.resize(capacity);
+        m_rows.clear();
+        m_next = 0;
+        endResetModel();
+    }
+    auto capacity() const -> int { return m_entries.size(); }
+    auto first() const -> quint64
+        { return m_next > (quint64)capacity() ? m_next - capacity() : 0; }
+    auto next() const -> quint64 { return m_next; }
+    auto keys() const -> QVector<LogKey> { return m_keys; }
+    auto entry(int row) const -> const LogEntry&
+        { return m_entries[m_rows[row] % capacity()]; }
+    auto append(const QVector<LogEntry> &entries, const LogFilter &filter) -> void
+    {
+        const int size = entries.size();
+        const int skip = qMax(0, size - capacity());
+        const auto first = m_next + size > (quint64)capacity()
+                ? m_next + size - capacity() : 0;
+        int evicted = 0;
+        while (evicted < (int)m_rows.size() && m_rows[evicted] < first)
+            ++evicted;
+        if (evicted > 0) {
+            beginRemoveRows(QModelIndex(), 0, evicted - 1);
+            m_rows.erase(m_rows.begin(), m_rows.begin() + evicted);
+            endRemoveRows();
+        }
+        m_next += skip;
+        QVector<quint64> accepted;
+        for (int i = skip; i < size; ++i, ++m_next) {
+            const int idx = m_next % capacity();
+            auto &key = m_keys[idx];
+            m_entries[idx] = entries[i];
+            key.level = entries[i].level;
+            key.context = entries[i].context;
+            if (filter.accepts(key))
+                accepted.push_back(m_next);
+        }
+        if (accepted.isEmpty())
+            return;
+        const int from = m_rows.size();
+        beginInsertRows(QModelIndex(), from, from + accepted.size() - 1);
+        m_rows.insert(m_rows.end(), accepted.cbegin(), accepted.cend());
+        endInsertRows();
+    }
+    // rows are filtered result for entries before next
+    auto setRows(QVector<quint64> &&rows, quint64 next, const LogFilter &filter) -> void
+    {
+        beginResetModel();
+        const auto first = this->first();
+        const auto it = std::lower_bound(rows.cbegin(), rows.cend(), first);
+        m_rows.assign(it, rows.cend());
+        for (auto seq = qMax(first, next); seq < m_next; ++seq) {
+            if (filter.accepts(m_keys[seq % capacity()]))
+                m_rows.push_back(seq);
+        }
+        endResetModel();
+    }
+    auto clear() -> void { setCapacity(capacity()); }
+    static auto filter(const QVector<LogKey> &keys, quint64 first, quint64 next,
+                       const LogFilter &filter) -> QVector<quint64>
     {
+        QVector<quint64> rows;
+        rows.reserve(next - first);
+        for (auto seq = first; seq < next; ++seq) {
+            if (filter.accepts(keys[seq % keys.size()]))
+                rows.push_back(seq);
+        }
+        return rows;
+    }
+    auto rowCount(const QModelIndex &parent) const -> int final
+        { return parent.isValid() ? 0 : m_rows.size(); }
+    auto data(const QModelIndex &index, int role) const -> QVariant final
+    {
+        if (!index.isValid() || index.row() >= (int)m_rows.size())
+            return QVariant();
         switch (role) {
+        case Qt::DisplayRole:
+            return entry(index.row()).message;
         case Qt::ForegroundRole:
-            return m_fgs[at(row).level];
+            return m_fgs[entry(index.row()).level];
         case Qt::BackgroundRole:
             return m_bg;
+        case Qt::FontRole:
+            return m_mono;
         }
         return QVariant();
     }
 private:
+    QVector<LogEntry> m_entries;
+    QVector<LogKey> m_keys;
+    std::deque<quint64> m_rows; // visible entries
+    quint64 m_next = 0;
     QBrush m_bg = Qt::black;
     QBrush m_fgs[Log::Trace + 1];
     QFont m_mono{u"monospace"_q};
 };
 
-class LogFilterModel : public QSortFilterProxyModel {
-public:
-    auto filterAcceptsRow(int srow, const QModelIndex &) const -> bool final
-    {
-        auto m = static_cast<LogEntryModel*>(sourceModel());
-        const auto &e = m->at(srow);
-        return level[e.level] && std::binary_search(ctx.begin(), ctx.end(), e.context);
-    }
-    QVector<QString> ctx;
-    std::array<bool, Log::Trace + 1> level;
-};
-
 struct LogViewer::Data {
     LogViewer *p = nullptr;
     Ui::LogViewer ui;
-    std::set<QString> ctx;
-    LogFilterModel proxy;
+    QHash<QString, int> ctx; // name -> id
+    LogFilter filter;
     LogEntryModel model;
-    int lines = 0;
+    QThreadPool pool;
+    int generation = 0;
     QMenu *menu = nullptr;
 
     struct {
@@ -112,21 +200,39 @@ struct LogViewer::Data {
     {
         for (auto i = 0; i < ui.level->count(); ++i) {
             const auto item = ui.level->item(i);
-            proxy.level[level(item)] = item->checkState();
+            filter.level[level(item)] = item->checkState();
         }
-        proxy.invalidate();
+        refilter();
     }
 
-    auto syncContext() -> void
+    auto updateContextFilter() -> void
     {
-        QVector<QString> ctx;
+        filter.context.fill(false, ctx.size());
         for (int i = 0; i < ui.context->count(); ++i) {
             auto item = ui.context->item(i);
-            if (item->checkState())
-                ctx.push_back(item->text());
+            filter.context[item->data(Qt::UserRole).toInt()] = item->checkState();
         }
-        proxy.ctx = ctx;
-        proxy.invalidate();
+    }
+
+    auto syncContext() -> void
+    {
+        updateContextFilter();
+        refilter();
+    }
+
+    // filters whole entries again in worker thread; stale results are ignored
+    auto refilter() -> void
+    {
+        const int gen = ++generation;
+        const auto keys = model.keys();
+        const auto first = model.first(), next = model.next();
+        const auto filter = this->filter;
+        const auto viewer = p;
+        pool.clear();
+        pool.start(_Runnable([=] () {
+            const auto rows = LogEntryModel::filter(keys, first, next, filter);
+            _PostEvent(viewer, FilterEvent, gen, rows, next);
+        }));
     }
 
     auto newItem(const QString &text, QListWidget *w) -> QListWidgetItem*
@@ -140,11 +246,12 @@ struct LogViewer::Data {
 
     auto newContext(const QString &name, bool checked) -> QListWidgetItem*
     {
-        if (ctx.find(name) != ctx.end())
+        if (ctx.contains(name))
             return nullptr;
         auto item = newItem(name, ui.context);
+        item->setData(Qt::UserRole, ctx.size());
         chceck(item, checked);
-        ctx.insert(name);
+        ctx.insert(name, ctx.size());
         return item;
     }
     auto restore() -> QRect
@@ -219,16 +326,16 @@ LogViewer::LogViewer(QWidget *parent)
     : QDialog(parent), d(new Data)
 {
     d->p = this;
-    std::fill(d->proxy.level.begin(), d->proxy.level.end(), true);
+    std::fill(d->filter.level.begin(), d->filter.level.end(), true);
+    d->pool.setMaxThreadCount(1);
     d->ui.setupUi(this);
     d->ui.view->viewport()->setStyleSheet("background-color: rgb(0, 0, 0);"_a);
     _SetWindowTitle(this, tr("Log Viewer"));
 
+    const int lines = Log::subscribe(this, LogEvent);
+    d->model.setCapacity(lines < _Max<int>() ? lines : DefaultLines);
     const auto geometry = d->restore();
-
-    d->lines = Log::subscribe(this, LogEvent);
-    d->proxy.setSourceModel(&d->model);
-    d->ui.view->setModel(&d->proxy);
+    d->ui.view->setModel(&d->model);
     d->createMenu();
 
     const QFontMetrics fm(font());
@@ -236,8 +343,8 @@ LogViewer::LogViewer(QWidget *parent)
     d->ui.level->setFixedWidth(mw);
     d->ui.level->setMaximumHeight(fm.height() * 10);
     connect(d->ui.level, &QListWidget::itemChanged, this, [=] (auto item) {
-        d->proxy.level[d->level(item)] = item->checkState();
-        d->proxy.invalidate();
+        d->filter.level[d->level(item)] = item->checkState();
+        d->refilter();
         d->setFilterChecked(d->ui.levelCheck, d->ui.level);
     });
 
@@ -292,34 +399,48 @@ LogViewer::~LogViewer()
     s.setValue(u"geometry"_q, geometry());
     s.setValue(u"autoscroll"_q, d->ui.autoscroll->isChecked());
     s.endGroup();
+    d->pool.clear();
+    d->pool.waitForDone();
     delete d;
 }
 
 auto LogViewer::customEvent(QEvent *ev) -> void
 {
-    if (ev->type() != LogEvent)
-        return;
-    LogEntry entry;
-    QByteArray data;
-    _TakeData(ev, entry.level, data);
-    entry.message = QString::fromLocal8Bit(data);
-    entry.message.chop(1);
-    Q_ASSERT(entry.message.at(3) == '['_q);
-    const int idx = entry.message.indexOf(']'_q, 4);
-    if (idx < 0) {
-        qDebug("Unkown logging context. Skip it.");
+    if (ev->type() == FilterEvent) {
+        int gen = 0; QVector<quint64> rows; quint64 next = 0;
+        _TakeData(ev, gen, rows, next);
+        if (gen != d->generation)
+            return;
+        d->model.setRows(std::move(rows), next, d->filter);
+    } else if (ev->type() == LogEvent) {
+        const auto messages = _MoveData<QVector<LogMessage>>(ev);
+        QVector<LogEntry> entries;
+        entries.reserve(messages.size());
+        bool added = false;
+        for (auto &msg : messages) {
+            LogEntry entry;
+            entry.level = msg.level;
+            entry.message = QString::fromLocal8Bit(msg.text);
+            entry.message.chop(1);
+            Q_ASSERT(entry.message.at(3) == '['_q);
+            const int idx = entry.message.indexOf(']'_q, 4);
+            if (idx < 0) {
+                qDebug("Unkown logging context. Skip it.");
+                continue;
+            }
+            const auto context = entry.message.mid(4, idx -4 );
+            if (d->newContext(context, true))
+                added = true;
+            entry.context = d->ctx.value(context);
+            entries.push_back(entry);
+        }
+        if (added) {
+            d->ui.context->sortItems();
+            d->updateContextFilter();
+        }
+        d->model.append(entries, d->filter);
+    } else
         return;
-    }
-    entry.context = entry.message.mid(4, idx -4 );
-    d->model.append(entry);
-
-    if (d->newContext(entry.context, true)) {
-        d->ui.context->sortItems();
-        d->syncContext();
-    }
-
-    if (d->model.rows() > d->lines)
-        d->model.remove(0);
     if (d->ui.autoscroll->isChecked())
         d->ui.view->scrollToBottom();
 }
@@ -0,0 +1,21 @@
+#ifndef RUNNABLE_HPP
+#define RUNNABLE_HPP
+
+#include "tmp/type_traits.hpp"
+#include <QRunnable>
+
+template<class F>
+class Runnable : public QRunnable {
+public:
+    Runnable(F f): m_func(std::move(f)) { }
+    auto run() -> void final { m_func(); }
+private:
+    F m_func;
+};
+
+// wraps a functor for QThreadPool::start() which takes ownership
+template<class F>
+SIA _Runnable(F &&f) -> QRunnable*
+    { return new Runnable<tmp::remove_cref_t<F>>(std::forward<F>(f)); }
+
+#endif // RUNNABLE_HPP
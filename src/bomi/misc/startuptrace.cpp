@@ -0,0 +1,129 @@
+#include "startuptrace.hpp"
+#include "log.hpp"
+
+DECLARE_LOG_CONTEXT(Startup)
+
+struct TraceEvent {
+    const char *name = nullptr;
+    char phase = 'X';
+    qint64 ts = 0, dur = 0; // in usecs
+    int tid = 0;
+};
+
+struct TraceData {
+    QString file;
+    QElapsedTimer timer;
+    QMutex mutex;
+    QVector<TraceEvent> events;
+    QHash<Qt::HANDLE, int> tids; // numbered in order of appearance
+    bool done = false;
+    auto tid() -> int
+    {
+        const auto id = QThread::currentThreadId();
+        auto it = tids.constFind(id);
+        if (it != tids.cend())
+            return *it;
+        const int tid = tids.size() + 1;
+        tids.insert(id, tid);
+        return tid;
+    }
+    auto add(const char *name, char phase, qint64 ts, qint64 dur) -> void
+    {
+        QMutexLocker locker(&mutex);
+        if (done)
+            return;
+        TraceEvent event;
+        event.name = name;
+        event.phase = phase;
+        event.ts = ts;
+        event.dur = dur;
+        event.tid = tid();
+        events.push_back(event);
+    }
+};
+
+static auto data() -> TraceData*
+{
+    static TraceData *d = [] () {
+        auto d = new TraceData;
+        d->file = QString::fromLocal8Bit(qgetenv("BOMI_STARTUP_TRACE"));
+        if (!d->file.isEmpty())
+            d->timer.start();
+        return d;
+    }();
+    return d;
+}
+
+auto StartupTrace::isEnabled() -> bool
+{
+    return !data()->file.isEmpty();
+}
+
+auto StartupTrace::now() -> qint64
+{
+    const auto d = data();
+    return d->file.isEmpty() ? -1 : d->timer.nsecsElapsed() / 1000;
+}
+
+auto StartupTrace::complete(const char *name, qint64 begin) -> void
+{
+    if (begin < 0)
+        return;
+    data()->add(name, 'X', begin, now() - begin);
+}
+
+auto StartupTrace::mark(const char *name) -> void
+{
+    const auto ts = now();
+    if (ts >= 0)
+        data()->add(name, 'i', ts, 0);
+}
+
+auto StartupTrace::finish(const char *reason) -> void
+{
+    const auto ts = now();
+    if (ts < 0)
+        return;
+    const auto d = data();
+    QMutexLocker locker(&d->mutex);
+    if (!_Change(d->done, true))
+        return;
+    const auto pid = QCoreApplication::applicationPid();
+    QJsonArray events;
+    auto push = [&] (const TraceEvent &e) {
+        QJsonObject json;
+        json[u"name"_q] = QString::fromLatin1(e.name);
+        json[u"cat"_q] = u"startup"_q;
+        json[u"ph"_q] = QString(QLatin1Char(e.phase));
+        json[u"ts"_q] = (double)e.ts;
+        if (e.phase == 'X')
+            json[u"dur"_q] = (double)e.dur;
+        else
+            json[u"s"_q] = u"g"_q;
+        json[u"pid"_q] = (double)pid;
+        json[u"tid"_q] = e.tid;
+        events.append(json);
+    };
+    for (auto &e : d->events)
+        push(e);
+    TraceEvent end;
+    end.name = reason;
+    end.phase = 'i';
+    end.ts = ts;
+    end.tid = d->tid();
+    push(end);
+
+    QJsonObject json;
+    json[u"traceEvents"_q] = events;
+    json[u"displayTimeUnit"_q] = u"ms"_q;
+    QSaveFile file(d->file);
+    if (!file.open(QFile::WriteOnly | QFile::Truncate)
+            || file.write(QJsonDocument(json).toJson(QJsonDocument::Compact)) < 0
+            || !file.commit()) {
+        _Error("Cannot write startup trace to %%.", d->file);
+        return;
+    }
+    _Info("Startup trace written to %%: %% ms until %%.",
+          d->file, ts / 1000, reason);
+    d->events.clear();
+}
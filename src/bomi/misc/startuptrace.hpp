@@ -0,0 +1,26 @@
+#ifndef STARTUPTRACE_HPP
+#define STARTUPTRACE_HPP
+
+// Records where startup time goes as Chrome trace events(chrome://tracing).
+// Enabled only when BOMI_STARTUP_TRACE environment variable has a file path.
+class StartupTrace {
+public:
+    // records time spent until going out of scope
+    class Scope {
+    public:
+        Scope(const char *name): m_name(name), m_begin(now()) { }
+        ~Scope() { complete(m_name, m_begin); }
+    private:
+        const char *m_name = nullptr;
+        qint64 m_begin = -1;
+    };
+    static auto isEnabled() -> bool;
+    static auto mark(const char *name) -> void;
+    // writes trace file once; events after this are ignored
+    static auto finish(const char *reason) -> void;
+private:
+    static auto now() -> qint64;
+    static auto complete(const char *name, qint64 begin) -> void;
+};
+
+#endif // STARTUPTRACE_HPP
@@ -0,0 +1,212 @@
+#include "urlresolver.hpp"
+#include "youtubedl.hpp"
+#include "yledl.hpp"
+#include "jsonstorage.hpp"
+#include "runnable.hpp"
+#include "log.hpp"
+#include <QThreadPool>
+
+DECLARE_LOG_CONTEXT(UrlResolver)
+
+struct UrlResolver::Data {
+    struct Entry {
+        Result result;
+        QDateTime expires;
+    };
+    YouTubeDL *youtube = nullptr;
+    YleDL *yle = nullptr;
+    int ttl = 3600;
+    QThreadPool pool;
+    QMutex running; // youtube-dl and yle-dl are not reentrant
+    QMutex mutex;   // below are guarded by this
+    QWaitCondition resolved;
+    QSet<QString> pending;
+    QSet<QString> queued; // prefetches not started yet; subset of pending
+    QHash<QString, Entry> cache;
+    bool loaded = false;
+
+    auto storage() const -> QString
+        { return _WritablePath(Location::Cache) % "/resolved.json"_a; }
+    auto cookies(const QString &url) const -> QString
+    {
+        const auto dir = _WritablePath(Location::Cache) % "/cookies"_a;
+        if (!QDir().mkpath(dir))
+            return QString();
+        const auto hash = QCryptographicHash::hash(url.toUtf8(), QCryptographicHash::Md5);
+        return dir % '/'_q % _L(hash.toHex());
+    }
+    auto find(const QString &url, Result *result) -> bool
+    {
+        auto it = cache.find(url);
+        if (it == cache.end())
+            return false;
+        if (it->expires < QDateTime::currentDateTimeUtc()) {
+            QFile::remove(it->result.cookies);
+            cache.erase(it);
+            return false;
+        }
+        *result = it->result;
+        return true;
+    }
+    auto load() -> void
+    {
+        if (!_Change(loaded, true))
+            return;
+        const auto now = QDateTime::currentDateTimeUtc();
+        const auto json = JsonStorage(storage()).read();
+        for (auto it = json.begin(); it != json.end(); ++it) {
+            const auto obj = it.value().toObject();
+            Entry entry;
+            entry.expires = QDateTime::fromString(obj[u"expires"_q].toString(), Qt::ISODate);
+            entry.result.url = obj[u"url"_q].toString();
+            entry.result.title = obj[u"title"_q].toString();
+            entry.result.cookies = obj[u"cookies"_q].toString();
+            entry.result.userAgent = obj[u"user_agent"_q].toString();
+            if (entry.expires < now || entry.result.url.isEmpty())
+                QFile::remove(entry.result.cookies);
+            else
+                cache.insert(it.key(), entry);
+        }
+    }
+    auto save() -> void
+    {
+        QJsonObject json;
+        for (auto it = cache.cbegin(); it != cache.cend(); ++it) {
+            QJsonObject obj;
+            obj.insert(u"expires"_q, it->expires.toString(Qt::ISODate));
+            obj.insert(u"url"_q, it->result.url);
+            obj.insert(u"title"_q, it->result.title);
+            obj.insert(u"cookies"_q, it->result.cookies);
+            obj.insert(u"user_agent"_q, it->result.userAgent);
+            json.insert(it.key(), obj);
+        }
+        JsonStorage(storage()).write(json);
+    }
+    // runs youtube-dl and caches result
+    auto fetch(const QString &url, Result *result) -> bool
+    {
+        QMutexLocker locker(&running);
+        if (!youtube->run(url))
+            return false;
+        const auto r = youtube->result();
+        if (r.url.isEmpty()) // playlist
+            return false;
+        result->url = r.url;
+        result->title = r.title;
+        result->userAgent = youtube->userAgent();
+        result->cookies = cookies(url);
+        if (!result->cookies.isEmpty()) {
+            QFile::remove(result->cookies);
+            QFile::copy(youtube->cookies(), result->cookies);
+        }
+        locker.unlock();
+
+        QMutexLocker cacheLocker(&mutex);
+        Entry entry;
+        entry.result = *result;
+        entry.expires = QDateTime::currentDateTimeUtc().addSecs(ttl);
+        cache.insert(url, entry);
+        save();
+        return true;
+    }
+    auto done(const QString &url) -> void
+    {
+        QMutexLocker locker(&mutex);
+        pending.remove(url);
+        resolved.wakeAll();
+    }
+};
+
+UrlResolver::UrlResolver()
+    : d(new Data)
+{
+    d->pool.setMaxThreadCount(1);
+}
+
+UrlResolver::~UrlResolver()
+{
+    d->pool.waitForDone();
+    delete d;
+}
+
+auto UrlResolver::setYouTube(YouTubeDL *youtube) -> void
+{
+    d->youtube = youtube;
+}
+
+auto UrlResolver::setYleDL(YleDL *yle) -> void
+{
+    d->yle = yle;
+}
+
+auto UrlResolver::setTimeToLive(int sec) -> void
+{
+    QMutexLocker locker(&d->mutex);
+    d->ttl = sec;
+}
+
+auto UrlResolver::prefetch(const QString &url) -> void
+{
+    if (!d->youtube || (d->yle && d->yle->supports(url)))
+        return;
+    QMutexLocker locker(&d->mutex);
+    d->load();
+    Result result;
+    if (d->pending.contains(url) || d->find(url, &result))
+        return;
+    d->pending.insert(url);
+    d->queued.insert(url);
+    _Debug("Prefetch %%", url);
+    d->pool.start(_Runnable([=] () {
+        {
+            QMutexLocker locker(&d->mutex);
+            if (!d->queued.remove(url)) // cancelled
+                return;
+        }
+        Result result;
+        d->fetch(url, &result);
+        d->done(url);
+    }));
+}
+
+auto UrlResolver::resolve(const QString &url, Result *result) -> bool
+{
+    if (d->yle && d->yle->supports(url)) {
+        QMutexLocker locker(&d->running);
+        if (!d->yle->run(url))
+            return false;
+        *result = Result();
+        result->url = d->yle->url();
+        return true;
+    }
+    if (!d->youtube)
+        return false;
+    QMutexLocker locker(&d->mutex);
+    d->load();
+    while (d->pending.contains(url)) // prefetching now
+        d->resolved.wait(&d->mutex);
+    // prefetch can fail or be cancelled; then resolve in foreground
+    if (d->find(url, result))
+        return true;
+    d->pending.insert(url);
+    locker.unlock();
+    const bool ok = d->fetch(url, result);
+    d->done(url);
+    return ok;
+}
+
+auto UrlResolver::cancel() -> void
+{
+    {
+        QMutexLocker locker(&d->mutex);
+        d->pool.clear();
+        for (auto &url : d->queued)
+            d->pending.remove(url);
+        d->queued.clear();
+        d->resolved.wakeAll();
+    }
+    if (d->youtube)
+        d->youtube->cancel();
+    if (d->yle)
+        d->yle->cancel();
+}
@@ -0,0 +1,32 @@
+#ifndef URLRESOLVER_HPP
+#define URLRESOLVER_HPP
+
+class YouTubeDL;                        class YleDL;
+
+// Resolves web page URLs into stream URLs by youtube-dl or yle-dl.
+// Results of youtube-dl are cached with their cookies across sessions until
+// they expire. yle-dl streams through a pipe, so it is never cached.
+class UrlResolver {
+public:
+    struct Result {
+        QString url, title;
+        QString cookies, userAgent; // empty unless youtube-dl is used
+    };
+    UrlResolver();
+    ~UrlResolver();
+    auto setYouTube(YouTubeDL *youtube) -> void;
+    auto setYleDL(YleDL *yle) -> void;
+    // seconds for which a resolved URL is reused
+    auto setTimeToLive(int sec) -> void;
+    // starts resolving url in background unless it is cached already
+    auto prefetch(const QString &url) -> void;
+    // blocks until url is resolved; false if not supported or failed
+    auto resolve(const QString &url, Result *result) -> bool;
+    // kills running resolution and drops queued prefetches
+    auto cancel() -> void;
+private:
+    struct Data;
+    Data *d;
+};
+
+#endif // URLRESOLVER_HPP
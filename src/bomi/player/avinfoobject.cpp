@@ -1,6 +1,7 @@
 #include "avinfoobject.hpp"
 #include "streamtrack.hpp"
 #include "video/videoformat.hpp"
+#include "video/frametimingrecorder.hpp"
 #include "audio/audioformat.hpp"
 
 template<class L, class T = typename std::remove_pointer<typename L::value_type>::type>
@@ -155,6 +156,43 @@ auto VideoFormatObject::spaceText() const -> QString
     return QString();
 }
 
+auto FrameTimingObject::setStats(const FrameTimingStats &stats) -> void
+{
+    QVariantList histogram;
+    histogram.reserve(stats.histogram.size());
+    for (auto count : stats.histogram)
+        histogram.push_back(count);
+    bool changed = false;
+    changed |= _Change(m_histogram, histogram);
+    changed |= _Change(m_late, stats.late);
+    changed |= _Change(m_interval, stats.interval);
+    changed |= _Change(m_jitter, stats.jitter);
+    changed |= _Change(m_render, stats.render);
+    changed |= _Change(m_gpu, stats.gpu);
+    changed |= _Change(m_latency, stats.latency);
+    if (changed)
+        emit this->changed();
+}
+
+/******************************************************************************/
+
+auto CacheObject::setStats(const QVariantMap &stats) -> void
+{
+    bool changed = false;
+    changed |= _Change(m_inRate, stats[u"in-rate"_q].toReal());
+    changed |= _Change(m_outRate, stats[u"out-rate"_q].toReal());
+    changed |= _Change(m_bytesIn, stats[u"bytes-in"_q].toReal());
+    changed |= _Change(m_bytesOut, stats[u"bytes-out"_q].toReal());
+    changed |= _Change(m_seeksCached, stats[u"seeks-cached"_q].toInt());
+    changed |= _Change(m_seeksMissed, stats[u"seeks-missed"_q].toInt());
+    changed |= _Change(m_underruns, stats[u"underruns"_q].toInt());
+    changed |= _Change(m_waitTime, stats[u"wait-time"_q].toReal());
+    if (changed)
+        emit this->changed();
+}
+
+/******************************************************************************/
+
 VideoObject::VideoObject()
 {
     connect(this, &VideoObject::delayedFramesChanged,
@@ -174,6 +212,16 @@ void VideoObject::setDroppedFrames(int f)
         emit droppedFpsChanged();
 }
 
+auto VideoObject::setFrameQueue(int late, int full, int depth) -> void
+{
+    bool changed = false;
+    changed |= _Change(m_lateDropped, late);
+    changed |= _Change(m_queueDropped, full);
+    changed |= _Change(m_queueDepth, depth);
+    if (changed)
+        emit frameQueueChanged();
+}
+
 auto VideoObject::delayedTime() const -> int
 {
     double fps = m_output.fps();
@@ -6,7 +6,7 @@
 #include <QQmlListProperty>
 
 class AudioFormat;                      class StreamTrack;
-class StreamList;
+class StreamList;                       struct FrameTimingStats;
 
 class CodecObject : public QObject {
     Q_OBJECT
@@ -182,6 +182,63 @@ private:
     QString m_driver;
 };
 
+class FrameTimingObject : public QObject {
+    Q_OBJECT
+    Q_PROPERTY(QVariantList histogram READ histogram NOTIFY changed)
+    Q_PROPERTY(int late READ late NOTIFY changed)
+    Q_PROPERTY(qreal interval READ interval NOTIFY changed)
+    Q_PROPERTY(qreal jitter READ jitter NOTIFY changed)
+    Q_PROPERTY(qreal render READ render NOTIFY changed)
+    Q_PROPERTY(qreal gpu READ gpu NOTIFY changed)
+    Q_PROPERTY(qreal latency READ latency NOTIFY changed)
+public:
+    auto histogram() const -> QVariantList { return m_histogram; }
+    auto late() const -> int { return m_late; }
+    auto interval() const -> qreal { return m_interval; }
+    auto jitter() const -> qreal { return m_jitter; }
+    auto render() const -> qreal { return m_render; }
+    auto gpu() const -> qreal { return m_gpu; }
+    auto latency() const -> qreal { return m_latency; }
+    auto setStats(const FrameTimingStats &stats) -> void;
+signals:
+    void changed();
+private:
+    QVariantList m_histogram;
+    int m_late = 0;
+    qreal m_interval = -1, m_jitter = -1, m_render = -1, m_gpu = -1;
+    qreal m_latency = -1;
+};
+
+// statistics of stream cache; rates in bytes/s
+class CacheObject : public QObject {
+    Q_OBJECT
+    Q_PROPERTY(qreal inRate READ inRate NOTIFY changed)
+    Q_PROPERTY(qreal outRate READ outRate NOTIFY changed)
+    Q_PROPERTY(qreal bytesIn READ bytesIn NOTIFY changed)
+    Q_PROPERTY(qreal bytesOut READ bytesOut NOTIFY changed)
+    Q_PROPERTY(int seeksCached READ seeksCached NOTIFY changed)
+    Q_PROPERTY(int seeksMissed READ seeksMissed NOTIFY changed)
+    Q_PROPERTY(int underruns READ underruns NOTIFY changed)
+    Q_PROPERTY(qreal waitTime READ waitTime NOTIFY changed)
+public:
+    auto inRate() const -> qreal { return m_inRate; }
+    auto outRate() const -> qreal { return m_outRate; }
+    auto bytesIn() const -> qreal { return m_bytesIn; }
+    auto bytesOut() const -> qreal { return m_bytesOut; }
+    auto seeksCached() const -> int { return m_seeksCached; }
+    auto seeksMissed() const -> int { return m_seeksMissed; }
+    auto underruns() const -> int { return m_underruns; }
+    auto waitTime() const -> qreal { return m_waitTime; }
+    // from mpv's cache-stats; empty map resets all
+    auto setStats(const QVariantMap &stats) -> void;
+signals:
+    void changed();
+private:
+    qreal m_inRate = 0, m_outRate = 0, m_bytesIn = 0, m_bytesOut = 0;
+    int m_seeksCached = 0, m_seeksMissed = 0, m_underruns = 0;
+    qreal m_waitTime = 0;
+};
+
 class VideoFormatObject : public AvCommonFormatObject {
     Q_OBJECT
     Q_PROPERTY(qreal fps READ fps NOTIFY fpsChanged)
@@ -241,11 +298,15 @@ class VideoObject : public AvCommonObject {
     Q_PROPERTY(VideoFormatObject *output READ output CONSTANT FINAL)
     Q_PROPERTY(VideoFormatObject *renderer READ renderer CONSTANT FINAL)
     Q_PROPERTY(VideoHwAccObject *hwacc READ hwacc CONSTANT FINAL)
+    Q_PROPERTY(FrameTimingObject *timing READ timing CONSTANT FINAL)
     Q_PROPERTY(int deinterlacer READ deinterlacer NOTIFY deinterlacerChanged)
     Q_PROPERTY(int droppedFrames READ droppedFrames NOTIFY droppedFramesChanged)
     Q_PROPERTY(int delayedFrames READ delayedFrames NOTIFY delayedFramesChanged)
     Q_PROPERTY(int delayedTime READ delayedTime NOTIFY delayedTimeChanged)
     Q_PROPERTY(qreal droppedFps READ droppedFps NOTIFY droppedFpsChanged)
+    Q_PROPERTY(int lateDroppedFrames READ lateDroppedFrames NOTIFY frameQueueChanged)
+    Q_PROPERTY(int queueDroppedFrames READ queueDroppedFrames NOTIFY frameQueueChanged)
+    Q_PROPERTY(int frameQueueDepth READ frameQueueDepth NOTIFY frameQueueChanged)
 public:
     VideoObject();
     auto input() const -> const VideoFormatObject* { return &m_input; }
@@ -256,6 +317,8 @@ public:
     auto output() -> VideoFormatObject* { return &m_output; }
     auto hwacc() -> VideoHwAccObject* { return &m_hwacc; }
     auto hwacc() const -> const VideoHwAccObject* { return &m_hwacc; }
+    auto timing() -> FrameTimingObject* { return &m_timing; }
+    auto timing() const -> const FrameTimingObject* { return &m_timing; }
     auto deinterlacer() const -> int { return m_deint; }
     auto setDeinterlacer(int deint) -> void
         { if (_Change(m_deint, deint)) emit deinterlacerChanged(); }
@@ -268,16 +331,24 @@ public:
     void setDroppedFrames(int f);
     void setDelayedFrames(int f)
         { if (_Change(m_delayed, f)) emit delayedFramesChanged(); }
+    // frames dropped in vo frame queue because they were late or queue was full
+    auto lateDroppedFrames() const -> int { return m_lateDropped; }
+    auto queueDroppedFrames() const -> int { return m_queueDropped; }
+    auto frameQueueDepth() const -> int { return m_queueDepth; }
+    auto setFrameQueue(int late, int full, int depth) -> void;
 signals:
     void deinterlacerChanged();
     void droppedFramesChanged();
     void droppedFpsChanged();
     void delayedFramesChanged();
     void delayedTimeChanged();
+    void frameQueueChanged();
 private:
     VideoFormatObject m_input, m_output, m_renderer;
     VideoHwAccObject m_hwacc;
+    FrameTimingObject m_timing;
     int m_deint = 0, m_dropped = 0, m_delayed = 0;
+    int m_lateDropped = 0, m_queueDropped = 0, m_queueDepth = 0;
     qreal m_droppedFps = 0.0, m_fpsMp = 1;
     QTime m_time;
 };
@@ -1,63 +1,64 @@
 #include "historymodel.hpp"
 #include "mrlstatesqlfield.hpp"
+#include "historywriter.hpp"
 #include "misc/log.hpp"
+#include "misc/dataevent.hpp"
+#include "misc/runnable.hpp"
+#include "misc/startuptrace.hpp"
 #include <QSqlDatabase>
 #include <QSqlError>
 #include <QQuickItem>
 #include <QSqlQuery>
 #include <QSqlRecord>
+#include <QCache>
+#include <QThreadPool>
+#include <QSemaphore>
 
 DECLARE_LOG_CONTEXT(History)
 
-class Transactor {
-public:
-    Transactor(QSqlDatabase *db, bool commit = true)
-        : m_db(db), m_commit(commit) { start(); }
-    ~Transactor() { done(); }
-    auto start() -> bool
-    {
-        if (m_doing)
-            return true;
-        return m_doing = check(m_db->transaction(), "transaction()"_b);
-    }
-    auto done() -> void
-    {
-        if (!m_doing)
-            return;
-        if (!m_commit || !check(m_db->commit(), "commit()"_b))
-            check(m_db->rollback(), "rollback()"_b);
-        m_doing = false;
-    }
-private:
-    auto check(bool ok, const char *at) const noexcept -> bool
-    {
-        if (!ok)
-            _Error("Error on %%: %%", at, m_db->lastError().text());
-        return ok;
-    }
-    QSqlDatabase *m_db = nullptr;
-    bool m_commit = true, m_doing = false;
-};
-
 auto reg_history_model() -> void { qmlRegisterType<HistoryModel>(); }
 
 struct RowCache { Mrl mrl; int row = -1; };
 
-static constexpr auto currentVersion = MrlState::Version + 1;
+struct HistoryItem {
+    QString id, device; // mrl as stored in table
+    qint64 last = 0;    // last_played_date_time in msecs
+};
+
+static constexpr int Loaded = QEvent::User;
+
+// number of mrls fetched by a query in prefetch
+static constexpr int PrefetchChunk = 64;
+
+// 4: array and object columns are stored in binary
+static constexpr auto currentVersion = MrlState::Version + 2;
 
 struct HistoryModel::Data {
     HistoryModel *p = nullptr;
     QSqlDatabase db;
+    HistoryWriter *writer = nullptr;
     RowCache rowCache;
-    QSqlQuery loader, finder;
+    // dedicated queries to keep each statement prepared
+    QSqlQuery finder, inserter, selector, prefetcher;
     QSqlError error;
     MrlStateSqlFieldList fields, restores;
-    MrlState cached;
+    // decoded rows by mrl, null for mrl not in table
+    QCache<QString, QSharedPointer<MrlState>> states{512};
+    int idx_mrl = -1;
     const MrlState default_{};
     const QString table = "state"_a % _N(currentVersion);
-    bool rememberImage = false, reload = true, visible = false;
-    int idx_mrl, idx_last, idx_device, rows = 0;
+    bool rememberImage = false, visible = false;
+    // ordered by last played time in descending order like view
+    QVector<HistoryItem> items;
+    QHash<QString, qint64> lasts; // id -> last played time
+    // a connection can be used only in its thread: one thread never expiring
+    QThreadPool pool;
     QMutex mutex;
+    QWaitCondition opened;
+    bool ready = false; // database has been opened in background
+    bool usable = false; // and opening succeeded
+    bool listed = false; // items have been loaded
+    QVector<HistoryItem> early; // items updated before listed
     auto check(const QSqlQuery &query) -> bool
     {
         if (!query.lastError().isValid())
@@ -68,35 +69,122 @@ struct HistoryModel::Data {
     }
     auto insert(const MrlState *state) -> bool
     {
-        if (state->mrl() == cached.mrl())
-            cached.set_mrl(Mrl());
-        fields.insert(finder, state);
-        return check(finder);
+        states.remove(state->mrl().toString());
+        fields.insert(inserter, state);
+        return check(inserter);
     }
-    auto load() -> bool
+    auto select() -> QVector<HistoryItem>
     {
-        const QString select = QString::fromLatin1(
-            "SELECT mrl, last_played_date_time, device, "
-            "(SELECT COUNT(*) FROM %1) as total "
-            "FROM %2 ORDER BY last_played_date_time DESC"
-        );
-        if (!loader.exec(select.arg(table).arg(table)))
-            return false;
-        Q_ASSERT(!loader.isForwardOnly());
-        p->beginResetModel();
-        rows = 0;
-        if (loader.next()) {
-            rows = loader.value(u"total"_q).toInt();
-            idx_mrl = 0;
-            idx_last = 1;
-            idx_device = 2;
-            loader.seek(-1);
+        QVector<HistoryItem> items;
+        QSqlQuery loader(db);
+        loader.setForwardOnly(true);
+        const auto select = u"SELECT mrl, device, last_played_date_time "
+                             "FROM %1 ORDER BY last_played_date_time DESC"_q;
+        if (!loader.exec(select.arg(table))) {
+            check(loader);
+            return items;
+        }
+        while (loader.next()) {
+            HistoryItem item;
+            item.id = loader.value(0).toString();
+            item.device = loader.value(1).toString();
+            item.last = loader.value(2).toLongLong();
+            items.push_back(item);
         }
+        items.squeeze();
+        return items;
+    }
+    auto reset(QVector<HistoryItem> &&items) -> void
+    {
+        p->beginResetModel();
+        this->items = std::move(items);
+        lasts.clear();
+        lasts.reserve(this->items.size());
+        for (auto &item : this->items)
+            lasts.insert(item.id, item.last);
         error = QSqlError();
-        p->endResetModel();
-        reload = false;
         rowCache = RowCache();
-        return true;
+        p->endResetModel();
+    }
+    // runs f in the thread owning db and waits for it; call with mutex locked
+    template<class F>
+    auto run(F &&f) -> void
+    {
+        QSemaphore done;
+        pool.start(_Runnable([&] () { f(); done.release(); }));
+        done.acquire();
+    }
+    auto load() -> void
+    {
+        mutex.lock();
+        wait();
+        if (writer)
+            writer->flush(true);
+        QVector<HistoryItem> items;
+        if (usable)
+            run([&] () { items = select(); });
+        mutex.unlock();
+        reset(std::move(items));
+        listed = true;
+        early.clear();
+    }
+    // call with mutex locked
+    auto wait() -> void
+    {
+        while (!ready)
+            opened.wait(&mutex);
+    }
+    // position for an item played at last; newer one comes first on tie
+    auto position(qint64 last) const -> int
+    {
+        auto it = std::lower_bound(items.begin(), items.end(), last,
+                                   [] (const HistoryItem &item, qint64 last)
+                                   { return item.last > last; });
+        return it - items.begin();
+    }
+    auto row(const QString &id) const -> int
+    {
+        auto it = lasts.constFind(id);
+        if (it == lasts.cend())
+            return -1;
+        for (int row = position(*it); row < items.size(); ++row) {
+            if (items[row].last != *it)
+                break;
+            if (items[row].id == id)
+                return row;
+        }
+        return -1;
+    }
+    // moves or inserts row for item without resetting model
+    auto place(const HistoryItem &item) -> void
+    {
+        const int from = row(item.id);
+        int to = position(item.last);
+        if (from < 0) {
+            p->beginInsertRows(QModelIndex(), to, to);
+            items.insert(to, item);
+            lasts.insert(item.id, item.last);
+            rowCache = RowCache();
+            p->endInsertRows();
+            return;
+        }
+        if (to > from)
+            --to;
+        if (to != from) {
+            p->beginMoveRows(QModelIndex(), from, from, QModelIndex(),
+                             to > from ? to + 1 : to);
+            items.remove(from);
+            items.insert(to, item);
+            lasts[item.id] = item.last;
+            rowCache = RowCache();
+            p->endMoveRows();
+        } else {
+            items[to] = item;
+            lasts[item.id] = item.last;
+            if (rowCache.row == to)
+                rowCache = RowCache();
+        }
+        emit p->dataChanged(p->index(to, 0), p->index(to, p->columnCount() - 1));
     }
     auto import(const QVector<MrlState*> &states) -> void
     {
@@ -112,11 +200,117 @@ struct HistoryModel::Data {
             delete state;
         }
     }
-    auto getMrl() const -> Mrl
+    auto fetch(const Mrl &mrl) -> QSharedPointer<MrlState>
+    {
+        const auto id = mrl.toString();
+        if (auto cached = states.object(id))
+            return *cached;
+        QSharedPointer<MrlState> state(new MrlState);
+        if (fields.select(selector, state.data(), mrl))
+            state->set_mrl(mrl);
+        else
+            state.reset();
+        states.insert(id, new QSharedPointer<MrlState>(state));
+        return state;
+    }
+    auto fetch(const QStringList &ids) -> void
+    {
+        Q_ASSERT(ids.size() <= PrefetchChunk);
+        for (int i = 0; i < PrefetchChunk; ++i)
+            prefetcher.bindValue(i, i < ids.size() ? QVariant(ids[i])
+                                                   : QVariant(QVariant::String));
+        if (!prefetcher.exec()) {
+            check(prefetcher);
+            return;
+        }
+        QSet<QString> missing = ids.toSet();
+        while (prefetcher.next()) {
+            QSharedPointer<MrlState> state(new MrlState);
+            int column = 0;
+            for (auto &f : fields)
+                f.exportTo(state.data(), prefetcher.value(column++));
+            const auto id = prefetcher.value(idx_mrl).toString();
+            missing.remove(id);
+            states.insert(id, new QSharedPointer<MrlState>(state));
+        }
+        prefetcher.finish();
+        for (auto &id : missing)
+            states.insert(id, new QSharedPointer<MrlState>());
+    }
+    // opens, migrates and reads database in pool thread which owns db
+    auto open() -> bool
+    {
+        StartupTrace::Scope trace("HistoryModel::open()");
+        db = QSqlDatabase::addDatabase(u"QSQLITE"_q, u"history-model"_q);
+        db.setDatabaseName(_WritablePath(Location::Config) % "/history.db"_a);
+        if (!db.open()) {
+            _Error("Error: %%. Couldn't create database.",
+                   db.lastError().text());
+            return false;
+        }
+
+        finder = QSqlQuery(db);
+        inserter = QSqlQuery(db);
+        selector = QSqlQuery(db);
+        prefetcher = QSqlQuery(db);
+
+        finder.exec(u"PRAGMA journal_mode = WAL"_q);
+        finder.exec(u"PRAGMA user_version"_q);
+        int version = 0;
+        if (finder.next())
+            version = finder.value(0).toLongLong();
+        if (version < currentVersion) {
+            const auto imports = _ImportMrlStates(version, db);
+            const bool imported = !imports.isEmpty();
+            import(imports);
+            finder.exec("PRAGMA user_version = "_a % _N(currentVersion));
+            if (imported) {
+                finder.exec("DROP TABLE IF EXISTS state"_a % _N(version));
+                finder.exec(u"VACUUM"_q);
+            }
+        } else {
+            auto record = db.record(table);
+            QVector<MrlStateSqlField> lacks;
+            for (const auto &field : fields) {
+                if (!record.contains(_L(field.property().name())))
+                    lacks.append(field);
+            }
+            if (!lacks.isEmpty()) {
+                Transactor t(&db);
+                for (auto &field : lacks) {
+                    const auto query = u"ALTER TABLE %3 ADD COLUMN %1 %2"_q
+                            .arg(_L(field.property().name())).arg(field.type());
+                    finder.exec(query.arg(table));
+                    check(finder);
+                }
+            }
+        }
+        // mrl is primary key and indexed already
+        finder.exec(u"CREATE INDEX IF NOT EXISTS %1_last_played ON %1 "
+                     "(last_played_date_time)"_q.arg(table));
+        check(finder);
+        _PostEvent(p, Loaded, select());
+
+        QStringList columns, phs;
+        for (auto &f : fields) {
+            if (!qstrcmp(f.property().name(), "mrl"))
+                idx_mrl = columns.size();
+            columns.push_back(_L(f.property().name()));
+        }
+        for (int i = 0; i < PrefetchChunk; ++i)
+            phs.push_back(u"?"_q);
+        prefetcher.prepare(u"SELECT %1 FROM %2 WHERE mrl IN (%3)"_q
+                           .arg(columns.join(','_q)).arg(table).arg(phs.join(','_q)));
+        check(prefetcher);
+
+        writer = new HistoryWriter(db.databaseName(), table, fields);
+        writer->start();
+        return true;
+    }
+    auto getMrl(int row) const -> Mrl
     {
-        const auto id = loader.value(idx_mrl).toString();
-        const auto dev = loader.value(idx_device).toString();
-        return Mrl::fromUniqueId(id, dev);
+        const auto &item = items[row];
+        return Mrl::fromUniqueId(item.id, item.device);
     }
 };
 
@@ -137,52 +331,48 @@ HistoryModel::HistoryModel(QObject *parent)
     d->fields.prepareSelect(d->table, d->fields.field(u"mrl"_q));
     setPropertiesToRestore(QStringList());
 
-    d->db = QSqlDatabase::addDatabase(u"QSQLITE"_q, u"history-model"_q);
-    d->db.setDatabaseName(_WritablePath(Location::Config) % "/history.db"_a);
-    if (!d->db.open()) {
-        _Error("Error: %%. Couldn't create database.",
-               d->db.lastError().text());
-        return;
-    }
-
-    d->loader = QSqlQuery(d->db);
-    d->finder = QSqlQuery(d->db);
-
-    d->finder.exec(u"PRAGMA journal_mode = WAL"_q);
-    d->finder.exec(u"PRAGMA user_version"_q);
-    int version = 0;
-    if (d->finder.next())
-        version = d->finder.value(0).toLongLong();
-    if (version < currentVersion) {
-        d->import(_ImportMrlStates(version, d->db));
-        d->finder.exec("PRAGMA user_version = "_a % _N(currentVersion));
-    } else {
-        auto record = d->db.record(d->table);
-        QVector<MrlStateSqlField> lacks;
-        for (const auto &field : d->fields) {
-            if (!record.contains(_L(field.property().name())))
-                lacks.append(field);
-        }
-        if (!lacks.isEmpty()) {
-            Transactor t(&d->db);
-            for (auto &field : lacks) {
-                const auto query = u"ALTER TABLE %3 ADD COLUMN %1 %2"_q
-                        .arg(_L(field.property().name())).arg(field.type());
-                d->finder.exec(query.arg(d->table));
-                d->check(d->finder);
-            }
-        }
-    }
-    d->load();
+    d->pool.setMaxThreadCount(1);
+    d->pool.setExpiryTimeout(-1);
+    d->pool.start(_Runnable([this] () {
+        const bool usable = d->open();
+        if (!usable) // show empty list anyway
+            _PostEvent(this, Loaded, QVector<HistoryItem>());
+        QMutexLocker locker(&d->mutex);
+        d->ready = true;
+        d->usable = usable;
+        d->opened.wakeAll();
+    }));
 }
 
 HistoryModel::~HistoryModel() {
+    d->mutex.lock();
+    d->wait();
+    d->run([this] () {
+        d->finder = d->inserter = d->selector = d->prefetcher = QSqlQuery();
+        d->db.close();
+        d->db = QSqlDatabase();
+        QSqlDatabase::removeDatabase(u"history-model"_q);
+    });
+    d->mutex.unlock();
+    d->pool.waitForDone();
+    delete d->writer;
     delete d;
 }
 
+auto HistoryModel::customEvent(QEvent *event) -> void
+{
+    if (event->type() != Loaded || d->listed)
+        return;
+    d->reset(_MoveData<QVector<HistoryItem>>(event));
+    d->listed = true;
+    for (auto &item : d->early)
+        d->place(item);
+    d->early.clear();
+}
+
 auto HistoryModel::rowCount(const QModelIndex &index) const -> int
 {
-    return index.isValid() ? 0 : d->rows;
+    return index.isValid() ? 0 : d->items.size();
 }
 
 auto HistoryModel::columnCount(const QModelIndex &index) const -> int
@@ -197,61 +387,67 @@ auto HistoryModel::getState(MrlState *state) const -> bool
         return false;
     if (d->restores.isEmpty())
         return true;
-    Q_ASSERT(d->restores.isSelectPrepared());
-    if (d->cached.mrl() != state->mrl())
-        return d->restores.select(d->finder, state);
+    d->wait();
+    if (d->writer && d->writer->read(d->restores, state))
+        return true;
+    if (!d->usable)
+        return false;
+    QSharedPointer<MrlState> cached;
+    d->run([&] () { cached = d->fetch(state->mrl()); });
+    if (!cached)
+        return false;
     for (auto &f : d->restores)
-        f.property().write(state, f.property().read(&d->cached));
+        f.property().write(state, f.property().read(cached.data()));
     return true;
 }
 
-auto HistoryModel::find(const Mrl &mrl) const -> const MrlState*
+auto HistoryModel::prefetch(const QList<Mrl> &mrls) const -> void
 {
     QMutexLocker locker(&d->mutex);
-    if (!mrl.isUnique())
-        return nullptr;
-    if (d->cached.mrl() == mrl)
-        return &d->cached;
-    Q_ASSERT(d->fields.isSelectPrepared());
-    if (!d->fields.select(d->finder, &d->cached, mrl))
-        return nullptr;
-    d->cached.set_mrl(mrl);
-    return &d->cached;
+    d->wait();
+    if (!d->usable)
+        return;
+    QStringList ids;
+    for (auto &mrl : mrls) {
+        if (ids.size() >= d->states.maxCost())
+            break; // more would evict what was just fetched
+        const auto id = mrl.toString();
+        if (mrl.isUnique() && !d->states.contains(id) && !ids.contains(id))
+            ids.push_back(id);
+    }
+    d->run([&] () {
+        for (int i = 0; i < ids.size(); i += PrefetchChunk)
+            d->fetch(ids.mid(i, PrefetchChunk));
+    });
+    if (!ids.isEmpty())
+        _Trace("Prefetched %% state(s)", ids.size());
 }
 
 auto HistoryModel::play(int row) -> void
 {
-    QMutexLocker locker(&d->mutex);
-    if (_InRange0(row, d->rows) && d->loader.seek(row))
-        emit playRequested(d->getMrl());
+    if (_InRange0(row, d->items.size()))
+        emit playRequested(d->getMrl(row));
 }
 
 auto HistoryModel::data(const QModelIndex &index, int role) const -> QVariant
 {
-//    QMutexLocker locker(&d->mutex);
-    if (d->reload) {
-        d->load();
-        d->reload = false;
-    }
     const int row = index.row();
-    if (!(0 <= row && row < d->rows))
-        return QVariant();
-    if (!d->loader.seek(row))
+    if (!_InRange0(row, d->items.size()))
         return QVariant();
     if (d->rowCache.row != row) {
         d->rowCache.row = row;
         d->rowCache.mrl = Mrl();
     }
-    auto fillMrl = [this] () -> const Mrl& {
+    auto fillMrl = [this, row] () -> const Mrl& {
         if (d->rowCache.mrl.isEmpty())
-            d->rowCache.mrl = d->getMrl();
+            d->rowCache.mrl = d->getMrl(row);
         return d->rowCache.mrl;
     };
     switch (role) {
     case NameRole:
         return fillMrl().displayName();
     case LatestPlayRole: {
-        const auto msecs = d->loader.value(d->idx_last).toLongLong();
+        const auto msecs = d->items[row].last;
         return QDateTime::fromMSecsSinceEpoch(msecs).toString(Qt::ISODate);
     } case LocationRole:
         return fillMrl().toString();
@@ -279,19 +475,27 @@ auto HistoryModel::update() -> void
     d->load();
 }
 
-auto HistoryModel::update(const MrlState *state, bool reload) -> void
+auto HistoryModel::update(const MrlState *state) -> void
 {
     Q_ASSERT(state);
-    QMutexLocker locker(&d->mutex);
     if (!d->rememberImage && state->mrl().isImage())
         return;
     if (!state->mrl().isUnique())
         return;
-    Transactor t(&d->db);
-    d->insert(state);
-    t.done();
-    if (reload)
-        update();
+    d->mutex.lock();
+    d->wait();
+    d->states.remove(state->mrl().toString());
+    d->mutex.unlock();
+    if (!d->writer || !d->writer->update(state))
+        return;
+    HistoryItem item;
+    item.id = state->mrl().toString();
+    item.device = state->device();
+    item.last = state->last_played_date_time().toMSecsSinceEpoch();
+    if (d->listed)
+        d->place(item);
+    else
+        d->early.push_back(item);
 }
 
 auto HistoryModel::setRememberImage(bool on) -> void
@@ -322,16 +526,22 @@ auto HistoryModel::setPropertiesToRestore(const QStringList &list) -> void
         if (props.contains(_L(f.property().name())))
             d->restores.push_back(f);
     }
-    d->restores.prepareSelect(d->table, d->fields.field(u"mrl"_q));
-    d->restores.prepareInsert(d->table);
 }
 
 auto HistoryModel::clear() -> void
 {
-    QMutexLocker locker(&d->mutex);
-    Transactor t(&d->db);
-    d->loader.exec("DELETE FROM "_a % d->table);
-    t.done();
+    d->mutex.lock();
+    d->wait();
+    if (d->writer)
+        d->writer->clear();
+    if (d->usable) {
+        d->run([this] () {
+            Transactor t(&d->db);
+            d->finder.exec("DELETE FROM "_a % d->table);
+        });
+    }
+    d->states.clear();
+    d->mutex.unlock();
     d->load();
 }
 
@@ -18,9 +18,10 @@ public:
               int role = Qt::DisplayRole) const -> QVariant;
     auto error() const -> QSqlError;
     auto roleNames() const -> QHash<int, QByteArray>;
-    auto find(const Mrl &mrl) const -> const MrlState*;
+    // decodes states of mrls in bulk to make following lookups hit memory
+    auto prefetch(const QList<Mrl> &mrls) const -> void;
     auto getState(MrlState *state) const -> bool;
-    auto update(const MrlState *state, bool reload) -> void;
+    auto update(const MrlState *state) -> void;
     auto setRememberImage(bool on) -> void;
     auto setPropertiesToRestore(const QStringList &properties) -> void;
     auto isRestorable(const char *name) const -> bool;
@@ -35,6 +36,7 @@ signals:
     void changeVisibilityRequested(bool visible);
     void visibleChanged(bool visible);
 private:
+    auto customEvent(QEvent *event) -> void override;
     struct Data;
     Data *d;
 };
@@ -0,0 +1,289 @@
+#include "historywriter.hpp"
+#include "mrlstate.hpp"
+#include "mrlstatesqlfield.hpp"
+#include "misc/log.hpp"
+#include <QSqlDatabase>
+#include <QSqlError>
+#include <QSqlQuery>
+
+DECLARE_LOG_CONTEXT(History)
+
+auto Transactor::start() -> bool
+{
+    if (m_doing)
+        return true;
+    return m_doing = check(m_db->transaction(), "transaction()"_b);
+}
+
+auto Transactor::done() -> void
+{
+    if (!m_doing)
+        return;
+    if (!m_commit || !check(m_db->commit(), "commit()"_b))
+        check(m_db->rollback(), "rollback()"_b);
+    m_doing = false;
+}
+
+auto Transactor::check(bool ok, const char *at) const noexcept -> bool
+{
+    if (!ok)
+        _Error("Error on %%: %%", at, m_db->lastError().text());
+    return ok;
+}
+
+/******************************************************************************/
+
+struct HistoryRow {
+    QVector<QVariant> values; // sql data of all fields
+    QBitArray dirty;
+    bool stored = false;      // false if row should be written as a whole
+};
+
+struct HistoryWrite {
+    QString id;
+    HistoryRow row;
+};
+
+struct HistoryWriter::Data {
+    QString database, table;
+    QVector<MrlStateSqlField> fields;
+    QHash<QString, int> columns; // name -> index in fields
+    int mrl = -1;
+    int interval = 2000;
+
+    mutable QMutex mutex;   // below are guarded by this
+    QWaitCondition wake, written;
+    QHash<QString, HistoryRow> rows; // rows touched in this session
+    QList<QString> queue;
+    QElapsedTimer queued;
+    bool quit = false, urgent = false, writing = false;
+
+    // only for writer thread
+    QSqlDatabase db;
+    QSqlQuery inserter;
+    QHash<QBitArray, QSqlQuery> updaters;
+
+    auto take() -> QVector<HistoryWrite>
+    {
+        QVector<HistoryWrite> batch;
+        batch.reserve(queue.size());
+        for (auto &id : queue) {
+            auto &row = rows[id];
+            batch.push_back({ id, row });
+            row.dirty.fill(false);
+            row.stored = true;
+        }
+        queue.clear();
+        return batch;
+    }
+    auto check(const QSqlQuery &query) -> bool
+    {
+        if (!query.lastError().isValid())
+            return true;
+        _Error("Error on query: %% for %%"
+               , query.lastError().text(), query.lastQuery());
+        return false;
+    }
+    auto updater(const QBitArray &dirty) -> QSqlQuery&
+    {
+        auto it = updaters.find(dirty);
+        if (it != updaters.end())
+            return *it;
+        QStringList sets;
+        for (int i = 0; i < fields.size(); ++i) {
+            if (dirty.testBit(i))
+                sets.push_back(_L(fields[i].property().name()) % "=?"_a);
+        }
+        QSqlQuery query(db);
+        query.prepare(u"UPDATE %1 SET %2 WHERE mrl=?"_q
+                      .arg(table).arg(sets.join(','_q)));
+        check(query);
+        return *updaters.insert(dirty, query);
+    }
+    auto write(const HistoryWrite &write) -> bool
+    {
+        auto &row = write.row;
+        if (!row.stored) {
+            for (int i = 0; i < row.values.size(); ++i)
+                inserter.bindValue(i, row.values[i]);
+            inserter.exec();
+            return check(inserter);
+        }
+        auto &query = updater(row.dirty);
+        int bind = 0;
+        for (int i = 0; i < row.values.size(); ++i) {
+            if (row.dirty.testBit(i))
+                query.bindValue(bind++, row.values[i]);
+        }
+        query.bindValue(bind, row.values[mrl]);
+        query.exec();
+        return check(query);
+    }
+    auto write(const QVector<HistoryWrite> &batch) -> void
+    {
+        Transactor t(&db);
+        for (auto &one : batch)
+            write(one);
+        t.done();
+        _Trace("Wrote %% row(s)", batch.size());
+    }
+};
+
+HistoryWriter::HistoryWriter(const QString &database, const QString &table,
+                             const MrlStateSqlFieldList &fields)
+    : d(new Data)
+{
+    d->database = database;
+    d->table = table;
+    for (auto &field : fields) {
+        const auto name = _L(field.property().name());
+        if (name == "mrl"_a)
+            d->mrl = d->fields.size();
+        d->columns.insert(name, d->fields.size());
+        d->fields.push_back(field);
+    }
+    Q_ASSERT(d->mrl != -1);
+}
+
+HistoryWriter::~HistoryWriter()
+{
+    d->mutex.lock();
+    d->quit = true;
+    d->wake.wakeAll();
+    d->mutex.unlock();
+    wait();
+    delete d;
+}
+
+auto HistoryWriter::setInterval(int ms) -> void
+{
+    QMutexLocker locker(&d->mutex);
+    d->interval = ms;
+    d->wake.wakeAll();
+}
+
+auto HistoryWriter::interval() const -> int
+{
+    QMutexLocker locker(&d->mutex);
+    return d->interval;
+}
+
+auto HistoryWriter::update(const MrlState *state) -> bool
+{
+    const auto id = state->mrl().toString();
+    QVector<QVariant> values(d->fields.size());
+    for (int i = 0; i < d->fields.size(); ++i) {
+        auto &f = d->fields[i];
+        values[i] = f.sqlData(f.property().read(state));
+    }
+    QMutexLocker locker(&d->mutex);
+    auto it = d->rows.find(id);
+    if (it == d->rows.end()) {
+        it = d->rows.insert(id, HistoryRow());
+        it->values = values;
+        it->dirty.fill(true, values.size());
+    } else {
+        bool changed = false;
+        for (int i = 0; i < values.size(); ++i) {
+            if (it->values[i] != values[i]) {
+                it->values[i] = values[i];
+                it->dirty.setBit(i);
+                changed = true;
+            }
+        }
+        if (!changed)
+            return false;
+    }
+    if (d->queue.contains(id))
+        return true;
+    if (d->queue.isEmpty())
+        d->queued.start();
+    d->queue.push_back(id);
+    d->wake.wakeAll();
+    return true;
+}
+
+auto HistoryWriter::read(const MrlStateSqlFieldList &fields,
+                         MrlState *state) const -> bool
+{
+    QMutexLocker locker(&d->mutex);
+    auto it = d->rows.constFind(state->mrl().toString());
+    if (it == d->rows.cend())
+        return false;
+    for (auto &f : fields) {
+        const int idx = d->columns.value(_L(f.property().name()), -1);
+        if (idx != -1)
+            f.exportTo(state, it->values[idx]);
+    }
+    return true;
+}
+
+auto HistoryWriter::flush(bool wait) -> void
+{
+    QMutexLocker locker(&d->mutex);
+    if (d->queue.isEmpty() && !d->writing)
+        return;
+    d->urgent = true;
+    d->wake.wakeAll();
+    while (wait && (d->writing || !d->queue.isEmpty()))
+        d->written.wait(&d->mutex);
+}
+
+auto HistoryWriter::clear() -> void
+{
+    QMutexLocker locker(&d->mutex);
+    d->queue.clear();
+    d->rows.clear();
+    while (d->writing)
+        d->written.wait(&d->mutex);
+}
+
+auto HistoryWriter::run() -> void
+{
+    const auto name = u"history-writer"_q;
+    {
+        d->db = QSqlDatabase::addDatabase(u"QSQLITE"_q, name);
+        d->db.setDatabaseName(d->database);
+        if (!d->db.open())
+            _Error("Error: %%. Couldn't open database.", d->db.lastError().text());
+        // WAL doesn't need full sync for each commit to be consistent
+        QSqlQuery(u"PRAGMA synchronous = NORMAL"_q, d->db);
+        d->inserter = QSqlQuery(d->db);
+        const auto cols = _ToStringList(d->fields, [] (const MrlStateSqlField &f) {
+            return QString::fromLatin1(f.property().name());
+        }).join(','_q);
+        QStringList phs;
+        for (int i = 0; i < d->fields.size(); ++i)
+            phs.push_back(u"?"_q);
+        d->inserter.prepare(u"INSERT OR REPLACE INTO %1 (%2) VALUES (%3)"_q
+                            .arg(d->table).arg(cols).arg(phs.join(','_q)));
+        d->check(d->inserter);
+
+        QMutexLocker locker(&d->mutex);
+        while (!d->quit || !d->queue.isEmpty()) {
+            if (d->queue.isEmpty()) {
+                d->urgent = false;
+                d->wake.wait(&d->mutex);
+                continue;
+            }
+            const auto remains = d->interval - d->queued.elapsed();
+            if (!d->quit && !d->urgent && remains > 0) {
+                d->wake.wait(&d->mutex, static_cast<ulong>(remains));
+                continue;
+            }
+            const auto batch = d->take();
+            d->urgent = false;
+            d->writing = true;
+            locker.unlock();
+            d->write(batch);
+            locker.relock();
+            d->writing = false;
+            d->written.wakeAll();
+        }
+        d->updaters.clear();
+        d->inserter = QSqlQuery();
+        d->db.close();
+        d->db = QSqlDatabase();
+    }
+    QSqlDatabase::removeDatabase(name);
+}
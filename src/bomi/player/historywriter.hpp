@@ -0,0 +1,44 @@
+#ifndef HISTORYWRITER_HPP
+#define HISTORYWRITER_HPP
+
+class MrlState;                         class MrlStateSqlFieldList;
+class QSqlDatabase;
+
+class Transactor {
+public:
+    Transactor(QSqlDatabase *db, bool commit = true)
+        : m_db(db), m_commit(commit) { start(); }
+    ~Transactor() { done(); }
+    auto start() -> bool;
+    auto done() -> void;
+private:
+    auto check(bool ok, const char *at) const noexcept -> bool;
+    QSqlDatabase *m_db = nullptr;
+    bool m_commit = true, m_doing = false;
+};
+
+// Writes MrlState rows behind the caller on its own connection.
+// Updates are coalesced per mrl and only changed columns are written.
+// Queued rows are committed in one transaction after interval or flush().
+class HistoryWriter : public QThread {
+public:
+    HistoryWriter(const QString &database, const QString &table,
+                  const MrlStateSqlFieldList &fields);
+    // commits all queued rows before returning
+    ~HistoryWriter();
+    auto setInterval(int ms) -> void;
+    auto interval() const -> int;
+    // queues state and returns false if nothing has been changed
+    auto update(const MrlState *state) -> bool;
+    // reads fields of state from rows queued or written in this session
+    auto read(const MrlStateSqlFieldList &fields, MrlState *state) const -> bool;
+    auto flush(bool wait = false) -> void;
+    // drops queued rows; rows being written are finished before return
+    auto clear() -> void;
+private:
+    auto run() -> void override;
+    struct Data;
+    Data *d;
+};
+
+#endif // HISTORYWRITER_HPP
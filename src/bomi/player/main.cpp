@@ -3,6 +3,7 @@
 #include "mainwindow.hpp"
 #include "misc/log.hpp"
 #include "misc/json.hpp"
+#include "misc/startuptrace.hpp"
 #include "quick/circularimageitem.hpp"
 #include "quick/maskareaitem.hpp"
 #include <QImageWriter>
@@ -27,6 +28,7 @@ extern QStringList writableImageExts;
 namespace OGL { auto check() -> void; }
 
 int main(int argc, char **argv) {
+    StartupTrace::mark("main()");
     qputenv("PX_MODULE_PATH", "/this-is-dummy-path-to-disable-libproxy");
 #ifdef Q_OS_LINUX
     auto gtk_disable_setlocale
@@ -37,21 +39,25 @@ int main(int argc, char **argv) {
 #endif
     QApplication::setAttribute(Qt::AA_X11InitThreads);
 
-    qmlRegisterType<CircularImageItem>("bomi", 1, 0, "CircularImage");
-    qmlRegisterType<MaskAreaItem>("bomi", 1, 0, "MaskArea");
-    qmlRegisterType<MouseEventObject>();
-    reg_theme_object();
-    reg_downloader();
-    reg_history_model();
-    reg_playlist_model();
-    reg_top_level_item();
-    reg_button_box_item();
-    reg_busy_icon_item();
-    reg_app_object();
-    reg_settings_object();
-    reg_play_engine();
+    {
+        StartupTrace::Scope trace("register QML types");
+        qmlRegisterType<CircularImageItem>("bomi", 1, 0, "CircularImage");
+        qmlRegisterType<MaskAreaItem>("bomi", 1, 0, "MaskArea");
+        qmlRegisterType<MouseEventObject>();
+        reg_theme_object();
+        reg_downloader();
+        reg_history_model();
+        reg_playlist_model();
+        reg_top_level_item();
+        reg_button_box_item();
+        reg_busy_icon_item();
+        reg_app_object();
+        reg_settings_object();
+        reg_play_engine();
+    }
 
     App app(argc, argv);
+    StartupTrace::mark("App created");
     for (auto fmt : QImageWriter::supportedImageFormats())
         writableImageExts.push_back(QString::fromLatin1(fmt));
 
@@ -61,13 +67,23 @@ int main(int argc, char **argv) {
         return 0;
     }
 
-    OGL::check();
-    MainWindow *mw = new MainWindow;
-    _Debug("Show MainWindow.");
-    mw->show();
+    MainWindow *mw = nullptr;
+    {
+        StartupTrace::Scope trace("OGL::check()");
+        OGL::check();
+    } {
+        StartupTrace::Scope trace("MainWindow::MainWindow()");
+        mw = new MainWindow;
+    } {
+        StartupTrace::Scope trace("MainWindow::show()");
+        _Debug("Show MainWindow.");
+        mw->show();
+    }
     app.setMainWindow(mw);
     _Debug("Start main event loop.");
+    StartupTrace::mark("exec()");
     auto ret = app.exec();
+    StartupTrace::finish("exit");
     _Debug("Exit...");
     return ret;
 }
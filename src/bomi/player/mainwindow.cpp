@@ -1,6 +1,7 @@
 #include "mainwindow_p.hpp"
 #include "app.hpp"
 #include "misc/trayicon.hpp"
+#include "misc/startuptrace.hpp"
 #include "dialog/mbox.hpp"
 #include "quick/appobject.hpp"
 
@@ -11,8 +12,11 @@ MainWindow::MainWindow(QWidget *parent)
 {
     d->p = this;
     d->view = new MainQuickView(this);
-    d->pref.initialize();
-    d->pref.load();
+    {
+        StartupTrace::Scope trace("Pref::load()");
+        d->pref.initialize();
+        d->pref.load();
+    }
     d->undo.setActive(false);
     d->logViewer = new LogViewer(this);
 
@@ -27,11 +31,19 @@ MainWindow::MainWindow(QWidget *parent)
     d->e.setHistory(&d->history);
     d->e.setYouTube(&d->youtube);
     d->e.setYle(&d->yle);
-    d->e.run();
-
-    d->initWindow();
-    d->initContextMenu();
-    d->initItems();
+    {
+        StartupTrace::Scope trace("PlayEngine::run()");
+        d->e.run();
+    } {
+        StartupTrace::Scope trace("MainWindow::Data::initWindow()");
+        d->initWindow();
+    } {
+        StartupTrace::Scope trace("MainWindow::Data::initContextMenu()");
+        d->initContextMenu();
+    } {
+        StartupTrace::Scope trace("MainWindow::Data::initItems()");
+        d->initItems();
+    }
     d->initTray();
 
     d->plugEngine();
@@ -53,6 +65,7 @@ MainWindow::~MainWindow() {
 
 auto MainWindow::postInitialize() -> void
 {
+    StartupTrace::Scope trace("MainWindow::postInitialize()");
     d->as.restoreWindowGeometry(this);
     d->applyPref();
     cApp.runCommands();
@@ -13,6 +13,7 @@
 #include "dialog/subtitlefinddialog.hpp"
 #include "dialog/encodingfiledialog.hpp"
 #include "video/interpolatorparams.hpp"
+#include <QFileDialog>
 
 template<class T, class Func>
 auto MainWindow::Data::push(const T &to, const T &from, const Func &func) -> QUndoCommand*
@@ -609,6 +610,23 @@ auto MainWindow::Data::plugMenu() -> void
         toggleTool("playinfo", as.playinfo_visible);
     });
     connect(tool[u"log"_q], &QAction::triggered, logViewer, &LogViewer::show);
+    connect(tool[u"frame-timing"_q], &QAction::triggered, p, [=] () {
+        const auto name = "bomi-frame-timing-"_a
+                % QDateTime::currentDateTime().toString(u"yyyy-MM-dd-hh-mm-ss"_q)
+                % ".csv"_a;
+        auto folder = _LastOpenPath(u"frame-timing"_q);
+        if (folder.isEmpty())
+            folder = QDir::homePath();
+        const auto file = QFileDialog::getSaveFileName(p, tr("Export Frame Timings"),
+            folder % '/'_q % name, tr("CSV Files") % " (*.csv)"_a);
+        if (file.isEmpty())
+            return;
+        _SetLastOpenPath(file, u"frame-timing"_q);
+        if (e.saveFrameTimings(file))
+            showMessage(tr("Frame timings exported"));
+        else
+            MBox::error(p, tr("Export Frame Timings"), tr("Cannot write %1.").arg(file), {BBox::Ok});
+    });
     connect(tool[u"subtitle"_q], &QAction::triggered, p, [this] () {
         if (!sview)
             sview = new SubtitleView(p);
@@ -158,7 +158,10 @@ auto MainWindow::Data::plugEngine() -> void
     });
     connect(&e, &PlayEngine::tick, p,
             [=] (int time) { if (ab.check(time)) e.seek(ab.a()); });
-    connect(&e, &PlayEngine::started, p, [=] (const Mrl &mrl) { setOpen(mrl); });
+    connect(&e, &PlayEngine::started, p, [=] (const Mrl &mrl) {
+        setOpen(mrl);
+        e.prefetch(playlist.nextMrl());
+    });
     connect(&e, &PlayEngine::finished, p, [=] (const Mrl &/*mrl*/, bool eof) {
         if (!eof) return;
         const auto next = playlist.checkNextMrl();
@@ -187,6 +190,8 @@ auto MainWindow::Data::initItems() -> void
             p, [this] (const Mrl &mrl) { openMrl(mrl); });
     connect(&playlist, &PlaylistModel::playRequested,
             p, [this] (int row) { openMrl(playlist.at(row)); });
+    connect(&playlist, &PlaylistModel::countChanged,
+            p, [this] () { e.prefetchStates(playlist.list()); });
 
     hider.setSingleShot(true);
     connect(&hider, &QTimer::timeout, p, [this] () { setCursorVisible(false); });
@@ -539,9 +544,14 @@ auto MainWindow::Data::applyPref() -> void
         cache.local = p.cache_local();
         cache.network = p.cache_network();
         cache.disc = p.cache_disc();
+        cache.connections = p.cache_connections();
         cache.min_playback = p.cache_min_playback() / 100.;
         cache.min_seeking = p.cache_min_seeking() / 100.;
         cache.remotes = p.network_folders();
+        if (p.cache_disk()) {
+            cache.disk = p.cache_disk_size() * 1024;
+            cache.dir = _WritablePath(Location::Cache) % "/stream"_a;
+        }
         return cache;
     };
     const auto chardet = p.sub_enc_autodetection() ? p.sub_enc_accuracy() * 1e-2 : -1;
@@ -563,9 +573,11 @@ auto MainWindow::Data::applyPref() -> void
     e.setClippingMethod_locked(p.clipping_method());
 
     e.setSubtitleStyle_locked(p.sub_style());
+    e.setSubtitleEffectsOnGpu_locked(p.sub_gpu_effects());
     e.setAutoselectMode_locked(p.sub_enable_autoselect(), p.sub_autoselect(), p.sub_ext());
     e.setSubtitleEncoding_locked(p.sub_enc(), chardet);
     e.unlock();
+    e.setDirectRendering(p.video_direct_rendering());
     e.reload();
 }
 
@@ -2,6 +2,7 @@
 #include <QOpenGLContext>
 
 static constexpr const int UpdateEventBegin = QEvent::User + 10000;
+static constexpr const int DeliverEvent = UpdateEventBegin - 1;
 
 auto Mpv::e2l(int error) -> Log::Level
 {
@@ -29,18 +30,93 @@ struct Mpv::Data {
     int hookId = 0;
     int viewport[4] = { 0, 0, 1, 1 };
     std::function<void(void)> update;
-    auto observation(int event) -> const PropertyObservation&
+    // mpv calls wakeup() from arbitrary thread whenever event queue gets
+    // non-empty; playloop sleeps on this instead of polling
+    QMutex wakeMutex;
+    QWaitCondition wakeCond;
+    bool woken = false;
+    struct {
+        int wakeups = 0, events = 0;
+        QElapsedTimer timer;
+    } stats;
+    auto wakeup() -> void
+    {
+        QMutexLocker locker(&wakeMutex);
+        woken = true;
+        wakeCond.wakeOne();
+    }
+    auto wait() -> void
+    {
+        QMutexLocker locker(&wakeMutex);
+        while (!woken)
+            wakeCond.wait(&wakeMutex);
+        woken = false;
+    }
+    // changed properties are marked in mpv thread and delivered in qt
+    // thread by single event; at most one DeliverEvent is in queue
+    QMutex dirtyMutex;
+    QBitArray dirty;
+    bool scheduled = false;
+    int interval = 16;
+    QElapsedTimer clock;
+    qint64 delivered = 0;
+    QTimer deliverer;
+    auto observation(int event) -> PropertyObservation&
     {
         Q_ASSERT(UpdateEventBegin <= event && event < updateEventMax);
         Q_ASSERT(event == observations[event - UpdateEventBegin].event);
         return observations[event - UpdateEventBegin];
     }
+    // force ignores interval to flush before other events from mpv thread
+    auto deliver(bool force = false) -> void
+    {
+        if (force && !deliverer.isActive()) {
+            QMutexLocker locker(&dirtyMutex);
+            if (!scheduled)
+                return; // nothing dirty
+        }
+        const auto now = clock.elapsed();
+        if (!force && now - delivered < interval) {
+            if (!deliverer.isActive())
+                deliverer.start(interval - (now - delivered));
+            return;
+        }
+        delivered = now;
+        dirtyMutex.lock();
+        const auto changed = dirty;
+        dirty.fill(false);
+        scheduled = false;
+        dirtyMutex.unlock();
+
+        qint64 wait = -1;
+        for (int i = 0; i < changed.size(); ++i) {
+            if (!changed.testBit(i))
+                continue;
+            auto &o = observations[i];
+            const auto past = now - o.delivered;
+            if (o.throttle > 0 && past < o.throttle) {
+                const auto left = o.throttle - past;
+                wait = wait < 0 ? left : qMin(wait, left);
+                dirtyMutex.lock();
+                dirty.setBit(i);
+                dirtyMutex.unlock();
+                continue;
+            }
+            o.delivered = now;
+            o.process();
+        }
+        if (wait >= 0 && !deliverer.isActive())
+            deliverer.start(qMax<qint64>(wait, interval));
+    }
 };
 
 Mpv::Mpv(QObject *parent)
     : QThread(parent), d(new Data)
 {
     d->p = this;
+    d->clock.start();
+    d->deliverer.setSingleShot(true);
+    connect(&d->deliverer, &QTimer::timeout, this, [=] () { d->deliver(); });
 }
 
 Mpv::~Mpv()
@@ -97,6 +173,21 @@ auto Mpv::render(GLuint fbo, const QSize &size) -> int
     return mpv_opengl_cb_render(d->gl, fbo, d->viewport);
 }
 
+auto Mpv::render(GLuint fbo, const QRect &viewport, bool flip) -> int
+{
+    int vp[4] = { viewport.x(), viewport.y(), viewport.width(),
+                  flip ? -viewport.height() : viewport.height() };
+    return mpv_opengl_cb_render(d->gl, fbo, vp);
+}
+
+auto Mpv::frameStats() const -> mpv_opengl_cb_frame_stats
+{
+    mpv_opengl_cb_frame_stats stats = {};
+    if (d->gl)
+        mpv_opengl_cb_get_frame_stats(d->gl, &stats);
+    return stats;
+}
+
 auto Mpv::initializeGL(QOpenGLContext *ctx) -> void
 {
     auto getProcAddr = [] (void *ctx, const char *name) -> void* {
@@ -134,18 +225,43 @@ auto Mpv::request(mpv_event_id id, std::function<void(mpv_event*)> &&proc) -> vo
     d->events[id] = std::move(proc);
 }
 
-auto Mpv::newObservation(const char *name, std::function<void(int)> &&notify,
-                  std::function<void(QEvent*)> &&process) -> int
+auto Mpv::setDeliveryInterval(int ms) -> void
+{
+    d->interval = qMax(0, ms);
+}
+
+auto Mpv::setThrottle(int event, int ms) -> void
+{
+    d->observation(event).throttle = ms;
+}
+
+auto Mpv::markDirty(int event) -> void
+{
+    QMutexLocker locker(&d->dirtyMutex);
+    d->dirty.setBit(event - UpdateEventBegin);
+    if (!d->scheduled) {
+        d->scheduled = true;
+        _PostEvent(m_observer, DeliverEvent);
+    }
+}
+
+auto Mpv::newObservation(const char *name, mpv_format format,
+                         std::function<void(int, void*)> &&notify,
+                         std::function<void(void)> &&process) -> int
 {
     const int event = d->updateEventMax++;
     PropertyObservation ob;
     ob.event = event;
     ob.name = name;
+    ob.format = format;
     ob.notify = std::move(notify);
     ob.process = std::move(process);
     d->observations.append(ob);
     Q_ASSERT(d->observations.size() == d->updateEventMax - UpdateEventBegin);
-    mpv_observe_property(m_handle, ob.event, ob.name, MPV_FORMAT_NONE);
+    d->dirtyMutex.lock();
+    d->dirty.resize(d->observations.size());
+    d->dirtyMutex.unlock();
+    mpv_observe_property(m_handle, ob.event, ob.name, ob.format);
     return event;
 }
 
@@ -165,80 +281,105 @@ auto Mpv::run() -> void
 {
     _Debug("Start playloop thread");
     d->quit = false;
+    auto wakeup = [] (void *p) -> void { static_cast<Data*>(p)->wakeup(); };
+    mpv_set_wakeup_callback(m_handle, wakeup, d);
+    d->woken = true; // for events queued before callback was set
+    d->stats.timer.start();
     while (!d->quit) {
-        auto ev = mpv_wait_event(m_handle, 0.005);
-        switch (ev->event_id) {
-        case MPV_EVENT_NONE:
-            break;
-        case MPV_EVENT_PROPERTY_CHANGE: {
-            auto &o = d->observation(ev->reply_userdata);
-            o.notify(o.event);
-            break;
-        } case MPV_EVENT_LOG_MESSAGE: {
-            auto msg = static_cast<mpv_event_log_message*>(ev->data);
-            if (msg->log_level == MPV_LOG_LEVEL_NONE)
+        d->wait();
+        ++d->stats.wakeups;
+        // drain all events queued until now in one go
+        while (!d->quit) {
+            auto ev = mpv_wait_event(m_handle, 0);
+            if (ev->event_id == MPV_EVENT_NONE)
                 break;
-            auto getLevel = [&]() {
-                switch (msg->log_level) {
-                case MPV_LOG_LEVEL_TRACE: return Log::Trace;
-                case MPV_LOG_LEVEL_V:
-                case MPV_LOG_LEVEL_DEBUG: return Log::Debug;
-                case MPV_LOG_LEVEL_INFO:  return Log::Info;
-                case MPV_LOG_LEVEL_WARN:  return Log::Warn;
-                default:                  return Log::Error;
-                }
-            };
-            const auto lv = getLevel();
-            Log::print(lv, Log::parse(lv, "mpv/"_b + msg->prefix, msg->text));
-            break;
-        } case MPV_EVENT_CLIENT_MESSAGE: {
-            auto message = static_cast<mpv_event_client_message*>(ev->data);
-            if (message->num_args < 1)
-                break;
-            if (!qstrcmp(message->args[0], "hook_run") && message->num_args == 3) {
-                QByteArray when(message->args[2]);
-                Q_ASSERT(d->hooks.contains(when));
-                d->hooks[when]();
-                tell("hook_ack", when);
-            }
-            break;
-        } case MPV_EVENT_SET_PROPERTY_REPLY: {
-            QScopedPointer<QByteArray> name(reinterpret_cast<QByteArray*>(ev->reply_userdata));
-            if (!isSuccess(ev->error)) {
-                _Debug("Error %%: Couldn't set property %%.",
-                       mpv_error_string(ev->error), *name);
-            }
+            ++d->stats.events;
+            dispatch(ev);
+        }
+        const auto elapsed = d->stats.timer.elapsed();
+        if (elapsed >= 10000) {
+            _Trace("Playloop woke up %% times/s for %% events/s.",
+                   d->stats.wakeups * 1e3 / elapsed, d->stats.events * 1e3 / elapsed);
+            d->stats.wakeups = d->stats.events = 0;
+            d->stats.timer.restart();
+        }
+    }
+    mpv_set_wakeup_callback(m_handle, nullptr, nullptr);
+    _Debug("Finish playloop thread");
+}
+
+auto Mpv::dispatch(mpv_event *ev) -> void
+{
+    switch (ev->event_id) {
+    case MPV_EVENT_NONE:
+        break;
+    case MPV_EVENT_PROPERTY_CHANGE: {
+        auto &o = d->observation(ev->reply_userdata);
+        auto prop = static_cast<mpv_event_property*>(ev->data);
+        o.notify(o.event, prop->format == o.format ? prop->data : nullptr);
+        break;
+    } case MPV_EVENT_LOG_MESSAGE: {
+        auto msg = static_cast<mpv_event_log_message*>(ev->data);
+        if (msg->log_level == MPV_LOG_LEVEL_NONE)
             break;
-        } case MPV_EVENT_COMMAND_REPLY: {
-            QScopedPointer<QByteArray> name(reinterpret_cast<QByteArray*>(ev->reply_userdata));
-            if (!isSuccess(ev->error)) {
-                _Debug("Error %%: Couldn't execute command %%.",
-                       mpv_error_string(ev->error), *name);
+        auto getLevel = [&]() {
+            switch (msg->log_level) {
+            case MPV_LOG_LEVEL_TRACE: return Log::Trace;
+            case MPV_LOG_LEVEL_V:
+            case MPV_LOG_LEVEL_DEBUG: return Log::Debug;
+            case MPV_LOG_LEVEL_INFO:  return Log::Info;
+            case MPV_LOG_LEVEL_WARN:  return Log::Warn;
+            default:                  return Log::Error;
             }
+        };
+        const auto lv = getLevel();
+        Log::print(lv, Log::parse(lv, "mpv/"_b + msg->prefix, msg->text));
+        break;
+    } case MPV_EVENT_CLIENT_MESSAGE: {
+        auto message = static_cast<mpv_event_client_message*>(ev->data);
+        if (message->num_args < 1)
             break;
-        } case MPV_EVENT_GET_PROPERTY_REPLY: {
-            auto event = static_cast<mpv_event_property*>(ev->data);
-            _Error("Never requested reply: %%", event->name);
+        if (!qstrcmp(message->args[0], "hook_run") && message->num_args == 3) {
+            QByteArray when(message->args[2]);
+            Q_ASSERT(d->hooks.contains(when));
+            d->hooks[when]();
+            tell("hook_ack", when);
+        }
+        break;
+    } case MPV_EVENT_SET_PROPERTY_REPLY: {
+        QScopedPointer<QByteArray> name(reinterpret_cast<QByteArray*>(ev->reply_userdata));
+        if (!isSuccess(ev->error)) {
+            _Debug("Error %%: Couldn't set property %%.",
+                   mpv_error_string(ev->error), *name);
+        }
+        break;
+    } case MPV_EVENT_COMMAND_REPLY: {
+        QScopedPointer<QByteArray> name(reinterpret_cast<QByteArray*>(ev->reply_userdata));
+        if (!isSuccess(ev->error)) {
+            _Debug("Error %%: Couldn't execute command %%.",
+                   mpv_error_string(ev->error), *name);
+        }
+        break;
+    } case MPV_EVENT_GET_PROPERTY_REPLY: {
+        auto event = static_cast<mpv_event_property*>(ev->data);
+        _Error("Never requested reply: %%", event->name);
+        break;
+    } case MPV_EVENT_SHUTDOWN:
+        d->quit = true;
+        break;
+    default: {
+        if (ev->event_id >= d->events.size())
             break;
-        } case MPV_EVENT_SHUTDOWN:
-            d->quit = true;
-            break;
-        default: {
-            if (ev->event_id >= d->events.size())
-                break;
-            if (auto &proc = d->events[ev->event_id])
-                proc(ev);
-        }}
-    }
-    _Debug("Finish playloop thread");
+        if (auto &proc = d->events[ev->event_id])
+            proc(ev);
+    }}
 }
 
 auto Mpv::process(QEvent *event) -> bool
 {
-    const int type = event->type();
-    if (UpdateEventBegin <= type && type < d->updateEventMax) {
-        d->observation(type).process(event);
-        return true;
-    }
-    return false;
+    // properties changed before this event was posted must not be applied
+    // after it, e.g. time-pos of old file after EndPlayback
+    const bool other = event->type() != DeliverEvent;
+    d->deliver(other);
+    return !other;
 }
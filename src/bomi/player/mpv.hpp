@@ -18,8 +18,12 @@ SCIA s2ms(double s) -> int { return s*1000 + 0.5; }
 struct PropertyObservation {
     int event;
     const char *name = nullptr;
-    std::function<void(int)> notify = nullptr;      // post from mpv to qt
-    std::function<void(QEvent*)> process = nullptr; // handle posted event
+    mpv_format format = MPV_FORMAT_NONE;
+    // convert payload in mpv thread; data is null if unavailable
+    std::function<void(int, void*)> notify = nullptr;
+    std::function<void(void)> process = nullptr; // apply latest value in qt
+    int throttle = 0; // minimum interval of delivery in ms
+    qint64 delivered = 0;
 };
 
 class Mpv : public QThread {
@@ -67,6 +71,12 @@ public:
     auto flush() { mpv_wait_async_requests(m_handle); }
 
     auto setObserver(QObject *observer) -> void { m_observer = observer; }
+    // all changed properties are delivered together at most once per interval
+    // and before any other event processed by process()
+    auto setDeliveryInterval(int ms) -> void;
+    // delivers property observed as event at most once per ms; throttled
+    // value can be applied after events posted later
+    auto setThrottle(int event, int ms) -> void;
     template<class Get, class Set>
     auto observe(const char *name, Get get, Set set) -> tmp::enable_if_callable_t<Get, int>;
     template<class T, class Update>
@@ -84,12 +94,16 @@ public:
         { request(id, [=] (mpv_event*) -> void { proc(); }); }
     auto setUpdateCallback(std::function<void(void)> &&cb) -> void;
     auto render(quint32 fbo, const QSize &size) -> int;
+    // flip renders bottom-up as default framebuffer of window
+    auto render(quint32 fbo, const QRect &viewport, bool flip) -> int;
+    auto frameStats() const -> mpv_opengl_cb_frame_stats;
     auto initializeGL(QOpenGLContext *ctx) -> void;
     auto finalizeGL() -> void;
 private:
     static auto e2s(int error) -> const char* { return mpv_error_string(error); }
     static auto e2l(int error) -> Log::Level;
     auto run() -> void override;
+    auto dispatch(mpv_event *event) -> void;
     auto fill(mpv_node *) { }
     template<class T, class... Args>
     auto fill(mpv_node *it, const T &t, const Args&... args)
@@ -108,8 +122,31 @@ private:
         const int error = f(&node);
         return CHECK_MPV(error, "execute %%", name);
     }
-    auto newObservation(const char *name, std::function<void(int)> &&notify,
-                        std::function<void(QEvent*)> &&process) -> int;
+    template<class T>
+    struct Latest { // value not delivered to qt yet
+        QMutex mutex;
+        T value;
+        bool pending = false; // value has not been taken by process
+    };
+    template<class T>
+    static auto convert(void *data) -> T
+    {
+        T t = T();
+        if (data)
+            trait<T>::get(t, *static_cast<type<T>*>(data));
+        return t;
+    }
+    // later changes overwrite value which has not been delivered yet
+    template<class T, class Get, class Set>
+    auto observeLatest(const char *name, mpv_format format, Get get, Set set) -> int;
+    template<class Get, class Set>
+    auto observeGet(const char *name, Get get, Set set, std::false_type) -> int;
+    template<class Get, class Set>
+    auto observeGet(const char *name, Get get, Set set, std::true_type) -> int;
+    auto newObservation(const char *name, mpv_format format,
+                        std::function<void(int, void*)> &&notify,
+                        std::function<void(void)> &&process) -> int;
+    auto markDirty(int event) -> void;
     struct Data; Data *d;
     mpv_handle *m_handle = nullptr;
     QObject *m_observer = nullptr;
@@ -180,39 +217,84 @@ template<int N, class... Args>
 auto Mpv::tellAsync(const char (&name)[N], const Args&... args) -> bool
     { return tellAsync(QByteArray::fromRawData(name, N), args...); }
 
+template<class T, class Get, class Set>
+auto Mpv::observeLatest(const char *name, mpv_format format, Get get, Set set) -> int
+{
+    auto latest = QSharedPointer<Latest<T>>::create();
+    return newObservation(name, format, [=] (int e, void *data) {
+        auto v = get(data);
+        latest->mutex.lock();
+        latest->value = std::move(v);
+        latest->pending = true;
+        latest->mutex.unlock();
+        markDirty(e);
+    }, [=] () {
+        // dirty bit can be set again after value was taken by last process
+        latest->mutex.lock();
+        if (!latest->pending) {
+            latest->mutex.unlock();
+            return;
+        }
+        T v = std::move(latest->value);
+        latest->pending = false;
+        latest->mutex.unlock();
+        set(std::move(v));
+    });
+}
+
+// get() queries other properties by itself
 template<class Get, class Set>
-auto Mpv::observe(const char *name, Get get, Set set) -> tmp::enable_if_callable_t<Get, int>
+auto Mpv::observeGet(const char *name, Get get, Set set, std::false_type) -> int
 {
     using T = tmp::remove_cref_t<decltype(get())>;
-    return newObservation(name, [=] (int e) { _PostEvent(m_observer, e, get()); },
-                          [=] (QEvent *event) { set(_MoveData<T>(event)); });
+    return observeLatest<T>(name, MPV_FORMAT_NONE, [=] (void*) { return get(); }, set);
+}
+
+// get(value) converts value of property
+template<class Get, class Set>
+auto Mpv::observeGet(const char *name, Get get, Set set, std::true_type) -> int
+{
+    using S = tmp::remove_cref_t<tmp::func_arg_t<Get, 0>>;
+    using T = tmp::remove_cref_t<decltype(get(S()))>;
+    return observeLatest<T>(name, trait<S>::format,
+                            [=] (void *data) { return get(convert<S>(data)); }, set);
+}
+
+template<class Get, class Set>
+auto Mpv::observe(const char *name, Get get, Set set) -> tmp::enable_if_callable_t<Get, int>
+{
+    using Typed = std::integral_constant<bool, (tmp::func_args<Get>() > 0)>;
+    return observeGet(name, get, set, Typed());
 }
 
 template<class T, class Update>
 auto Mpv::observe(const char *name, T &t, Update update) -> tmp::enable_unless_callable_t<T, int>
 {
-    return observe(name, [=] () { return get<T>(name); },
-                   [=, &t] (T &&v) { if (_Change(t, v)) update(); });
+    return observeLatest<T>(name, trait<T>::format, convert<T>,
+                            [=, &t] (T &&v) { if (_Change(t, v)) update(); });
 }
 
 template<class Update>
 auto Mpv::observeTime(const char *name, int &t, Update update) -> int
 {
-    return observe(name, [=] () { return s2ms(get<double>(name)); },
-                   [=, &t] (int &&v) { if (_Change(t, v)) update(); });
+    return observeLatest<int>(name, MPV_FORMAT_DOUBLE,
+                              [] (void *data) { return s2ms(convert<double>(data)); },
+                              [=, &t] (int &&v) { if (_Change(t, v)) update(); });
 }
 
 template<class Set>
 auto Mpv::observe(const char *name, Set set) -> int {
-    using T = tmp::remove_ref_t<tmp::func_arg_t<Set, 0>>;
-    return observe(name, [=] () { return get<T>(name); }, set);
+    using T = tmp::remove_cref_t<tmp::func_arg_t<Set, 0>>;
+    return observeLatest<T>(name, trait<T>::format, convert<T>, set);
 }
 
 template<class Check>
 auto Mpv::observeState(const char *name, Check ck) -> int
 {
-    using T = tmp::remove_ref_t<tmp::func_arg_t<Check, 0>>;
-    return newObservation(name, [=] (int) { ck(get<T>(name)); }, [](QEvent*){});
+    using T = tmp::remove_cref_t<tmp::func_arg_t<Check, 0>>;
+    return newObservation(name, trait<T>::format,
+                          [=] (int, void *data) { ck(convert<T>(data)); },
+                          [] () { });
 }
 
 #endif // MPV_HPP
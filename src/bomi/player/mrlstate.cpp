@@ -1,9 +1,13 @@
 #include "mrlstate.hpp"
 #include "mrlstate_p.hpp"
+#include "mrlstatesqlfield.hpp"
 #include "misc/json.hpp"
 #include "misc/jsonstorage.hpp"
 #include "misc/log.hpp"
 #include <QSqlDatabase>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QSqlRecord>
 
 DECLARE_LOG_CONTEXT(History)
 
@@ -157,9 +161,39 @@ auto MrlState::restorableProperties() -> QVector<PropertyInfo>
 auto _ImportMrlStates(int version, QSqlDatabase db)
 -> QVector<MrlState*>
 {
-    Q_UNUSED(db);
     QVector<MrlState*> states;
-    if (version < 3)
+    if (version < 3) {
         _Error("This version of history database is not supported.");
+        return states;
+    }
+    // version 3 has structured columns in json text which fields still read
+    const auto table = "state"_a % _N(version);
+    const auto record = db.record(table);
+    if (record.isEmpty())
+        return states;
+    const MrlState def;
+    const auto mo = def.metaObject();
+    QVector<MrlStateSqlField> fields;
+    QStringList columns;
+    for (int i = 1; i < mo->propertyCount(); ++i) {
+        const auto property = mo->property(i);
+        if (!record.contains(_L(property.name())))
+            continue;
+        fields.push_back({ property, property.read(&def) });
+        columns.push_back(_L(property.name()));
+    }
+    QSqlQuery query(db);
+    query.setForwardOnly(true);
+    if (!query.exec(u"SELECT %1 FROM %2"_q.arg(columns.join(','_q)).arg(table))) {
+        _Error("Cannot import %%: %%", table, query.lastError().text());
+        return states;
+    }
+    while (query.next()) {
+        auto state = new MrlState;
+        for (int i = 0; i < fields.size(); ++i)
+            fields[i].exportTo(state, query.value(i));
+        states.push_back(state);
+    }
+    _Info("Imported %% item(s) from %%", states.size(), table);
     return states;
 }
@@ -19,25 +19,35 @@
 #include "enum/subtitledisplay.hpp"
 
 struct CacheInfo {
-    auto get(const Mrl &mrl) const -> int
+    auto isRemote(const Mrl &mrl) const -> bool
     {
         if (mrl.isLocalFile()) {
             auto path = mrl.toLocalFile();
             for (auto &folder : remotes) {
                 if (path.startsWith(folder))
-                    return network;
+                    return true;
             }
-            return local;
+            return false;
         }
-        if (mrl.isDisc())
-            return disc;
-        return network;
+        return !mrl.isDisc();
+    }
+    auto get(const Mrl &mrl) const -> int
+    {
+        if (isRemote(mrl))
+            return network;
+        return mrl.isDisc() ? disc : local;
     }
+    // remote media is kept on disk across sessions if enabled
+    auto persistent(const Mrl &mrl) const -> bool
+        { return disk > 0 && !dir.isEmpty() && isRemote(mrl); }
     auto playback(int cache) const -> int { return cache * min_playback; }
     auto seeking(int cache) const -> int { return cache * min_seeking; }
     int local = 0, network = 25000, disc = 0;
     double min_playback = 0, min_seeking = 2;
     QStringList remotes;
+    int disk = 0; // in KiB; 0 if disabled
+    QString dir;
+    int connections = 1; // for network media
 };
 
 class MrlState : public QObject {
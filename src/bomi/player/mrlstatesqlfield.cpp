@@ -1,12 +1,126 @@
 #include "mrlstatesqlfield.hpp"
 #include "mrl.hpp"
 #include "misc/jsonstorage.hpp"
+#include <QSqlError>
 #include <QSqlQuery>
 #include <QSqlRecord>
 
 template<class T>
 SIA _Is(int type) -> bool { return qMetaTypeId<T>() == type; }
 
+// binary form of json for array and object columns:
+// version followed by values of tag and payload in QDataStream
+static constexpr quint8 BinaryVersion = 1;
+
+enum BinaryTag : quint8 { Null, False, True, Int, Double, String, Array, Object };
+
+static auto writeJson(QDataStream &out, const QJsonValue &json) -> void
+{
+    switch (json.type()) {
+    case QJsonValue::Bool:
+        out << quint8(json.toBool() ? True : False);
+        break;
+    case QJsonValue::Double: {
+        const auto value = json.toDouble();
+        if (std::numeric_limits<qint32>::min() <= value
+                && value <= std::numeric_limits<qint32>::max()
+                && qint32(value) == value)
+            out << quint8(Int) << qint32(value);
+        else
+            out << quint8(Double) << value;
+        break;
+    } case QJsonValue::String:
+        out << quint8(String) << json.toString().toUtf8();
+        break;
+    case QJsonValue::Array: {
+        const auto array = json.toArray();
+        out << quint8(Array) << quint32(array.size());
+        for (const auto &value : array)
+            writeJson(out, value);
+        break;
+    } case QJsonValue::Object: {
+        const auto object = json.toObject();
+        out << quint8(Object) << quint32(object.size());
+        for (auto it = object.begin(); it != object.end(); ++it) {
+            out << it.key().toUtf8();
+            writeJson(out, it.value());
+        }
+        break;
+    } default:
+        out << quint8(Null);
+    }
+}
+
+static auto readJson(QDataStream &in) -> QJsonValue
+{
+    quint8 tag = Null;
+    in >> tag;
+    switch (tag) {
+    case False: case True:
+        return tag == True;
+    case Int: {
+        qint32 value = 0; in >> value;
+        return value;
+    } case Double: {
+        double value = 0; in >> value;
+        return value;
+    } case String: {
+        QByteArray value; in >> value;
+        return QString::fromUtf8(value);
+    } case Array: {
+        quint32 size = 0; in >> size;
+        QJsonArray array;
+        for (quint32 i = 0; i < size && in.status() == QDataStream::Ok; ++i)
+            array.append(readJson(in));
+        return array;
+    } case Object: {
+        quint32 size = 0; in >> size;
+        QJsonObject object;
+        for (quint32 i = 0; i < size && in.status() == QDataStream::Ok; ++i) {
+            QByteArray key; in >> key;
+            object.insert(QString::fromUtf8(key), readJson(in));
+        }
+        return object;
+    } default:
+        return QJsonValue();
+    }
+}
+
+static auto _JsonToBinary(const QJsonValue &json) -> QByteArray
+{
+    QByteArray data;
+    QDataStream out(&data, QIODevice::WriteOnly);
+    out.setVersion(QDataStream::Qt_5_2);
+    out << BinaryVersion;
+    writeJson(out, json);
+    return data;
+}
+
+// accepts json text of old tables too
+static auto _JsonFromSqlData(const QVariant &data) -> QJsonValue
+{
+    if (data.userType() == QMetaType::QString) {
+        QJsonParseError e;
+        const auto doc = QJsonDocument::fromJson(data.toString().toUtf8(), &e);
+        if (e.error)
+            return QJsonValue(QJsonValue::Undefined);
+        return doc.isArray() ? QJsonValue(doc.array()) : QJsonValue(doc.object());
+    }
+    if (data.userType() != QMetaType::QByteArray)
+        return QJsonValue(QJsonValue::Undefined);
+    const auto bytes = data.toByteArray();
+    QDataStream in(bytes);
+    in.setVersion(QDataStream::Qt_5_2);
+    quint8 version = 0;
+    in >> version;
+    if (version != BinaryVersion)
+        return QJsonValue(QJsonValue::Undefined);
+    const auto json = readJson(in);
+    if (in.status() != QDataStream::Ok)
+        return QJsonValue(QJsonValue::Undefined);
+    return json;
+}
+
 MrlStateSqlField::MrlStateSqlField(const QMetaProperty &property,
                                    const QVariant &def) noexcept
     : m_property(property)
@@ -61,25 +175,15 @@ MrlStateSqlField::MrlStateSqlField(const QMetaProperty &property,
             };
             break;
         case QJsonValue::Array:
-            m_v2d = [] (const QVariant &value) -> QVariant
-                { return QString::fromUtf8(QJsonDocument(_JsonFromQVariant(value).toArray()).toJson()); };
-            m_d2v = [] (const QVariant &data, int type) -> QVariant {
-                QJsonParseError e;
-                const auto doc = QJsonDocument::fromJson(data.toString().toUtf8(), &e);
-                if (e.error || !doc.isArray())
-                    return QVariant();
-                return _JsonToQVariant(doc.array(), type);
-            };
-            break;
         case QJsonValue::Object:
+            m_sqlType = u"BLOB"_q;
             m_v2d = [] (const QVariant &value) -> QVariant
-                { return QString::fromUtf8(QJsonDocument(_JsonFromQVariant(value).toObject()).toJson()); };
+                { return _JsonToBinary(_JsonFromQVariant(value)); };
             m_d2v = [] (const QVariant &data, int type) -> QVariant {
-                QJsonParseError e;
-                const auto doc = QJsonDocument::fromJson(data.toString().toUtf8(), &e);
-                if (e.error || !doc.isObject())
+                const auto json = _JsonFromSqlData(data);
+                if (!json.isArray() && !json.isObject())
                     return QVariant();
-                return _JsonToQVariant(doc.object(), type);
+                return _JsonToQVariant(json, type);
             };
             break;
         default:
@@ -115,6 +219,15 @@ auto MrlStateSqlFieldList::prepareInsert(const QString &table) -> QString
     return insert;
 }
 
+auto MrlStateSqlFieldList::prepare(QSqlQuery &query, QueryType type) const -> bool
+{
+    // skip parsing of statement if query already holds it from last call
+    const auto &sql = m_queries[type];
+    if (query.lastQuery() == sql && !query.lastError().isValid())
+        return true;
+    return query.prepare(sql);
+}
+
 auto MrlStateSqlFieldList::field(const QString &name) const -> Field
 {
     for (auto &field : m_fields) {
@@ -146,9 +259,9 @@ auto MrlStateSqlFieldList::select(QSqlQuery &query, QObject *object,
     auto &select = m_queries[Select];
     if (select.isEmpty())
         return false;
-    if (!query.prepare(select))
+    if (!prepare(query, Select))
         return false;
-    query.addBindValue(m_where.sqlData(where));
+    query.bindValue(0, m_where.sqlData(where));
     if (!query.exec() || !query.next())
         return false;
     const auto record = query.record();
@@ -156,6 +269,7 @@ auto MrlStateSqlFieldList::select(QSqlQuery &query, QObject *object,
         Q_ASSERT(_L(m_fields[i].property().name()) == record.fieldName(i));
         m_fields[i].exportTo(object, record.value(i));
     }
+    query.finish();
     return true;
 }
 
@@ -163,7 +277,7 @@ auto MrlStateSqlFieldList::insert(QSqlQuery &query, const QObject *o) -> bool
 {
     if (!isInsertPrepared())
         return false;
-    if (!query.prepare(m_queries[Insert]))
+    if (!prepare(query, Insert))
         return false;
     for (int i=0; i<m_fields.size(); ++i) {
         auto &f = m_fields[i];
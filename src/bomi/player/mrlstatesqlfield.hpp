@@ -52,6 +52,8 @@ public:
     auto prepareInsert(const QString &table) -> QString;
     auto prepareSelect(const QString &table, const Field &where) -> QString;
     auto field(const QString &name) const -> Field;
+    // query is prepared only when it does not hold the statement already;
+    // keep a dedicated query for each statement to reuse it
     auto insert(QSqlQuery &query, const QObject *object) -> bool;
     auto select(QSqlQuery &query, QObject *object) const -> bool
         { return select(query, object, m_where.property().read(object)); }
@@ -65,6 +67,7 @@ public:
         { return !m_queries[type].isEmpty(); }
     auto query(QueryType type) -> QString const { return m_queries[type]; }
 private:
+    auto prepare(QSqlQuery &query, QueryType type) const -> bool;
     QVector<QString> m_queries = QVector<QString>(MaxType);
     QVector<Field> m_fields;
     MrlStateSqlField m_where;
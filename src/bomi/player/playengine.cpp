@@ -4,6 +4,8 @@
 #include "audio/audionormalizeroption.hpp"
 #include "subtitle/subtitlemodel.hpp"
 #include "os/os.hpp"
+#include <QQuickWindow>
+#include <QScreen>
 
 PlayEngine::PlayEngine()
 : d(new Data(this)) {
@@ -15,6 +17,9 @@ PlayEngine::PlayEngine()
     d->vr->setOverlay(d->sr);
     d->vr->setRenderFrameFunction([this] (OpenGLFramebufferObject *fbo)
         { d->renderVideoFrame(fbo); });
+    d->vr->setRenderDirectFunction([this] (GLuint fbo, const QRect &vp,
+                                           bool flip, bool redraw)
+        { d->renderVideoDirect(fbo, vp, flip, redraw); });
 
     d->params.m_mutex = &d->mutex;
 
@@ -91,6 +96,20 @@ PlayEngine::PlayEngine()
         d->post(Searching, skipping);
     }, Qt::DirectConnection);
     connect(d->vp, &VideoProcessor::seekRequested, this, &PlayEngine::seek);
+    connect(d->vp, &VideoProcessor::frameFiltered, this, [=] ()
+        { d->frames.timing.stamp(FrameTimingRecorder::Decoded); }, Qt::DirectConnection);
+    connect(d->vr, &QQuickItem::windowChanged, this, [=] (QQuickWindow *w) {
+        disconnect(d->frames.swapped);
+        disconnect(d->frames.screen);
+        if (!w)
+            return;
+        d->frames.swapped = connect(w, &QQuickWindow::frameSwapped, this,
+                [=] () { d->frames.timing.swapped(); }, Qt::DirectConnection);
+        auto setRefreshRate = [=] (QScreen *screen)
+            { d->frames.timing.setRefreshRate(screen ? screen->refreshRate() : 0.0); };
+        d->frames.screen = connect(w, &QWindow::screenChanged, this, setRefreshRate);
+        setRefreshRate(w->screen());
+    });
     connect(d->vp, &VideoProcessor::fpsManimulated, &d->info.video,
             &VideoObject::setFpsManimulation, Qt::QueuedConnection);
 
@@ -112,6 +131,9 @@ PlayEngine::PlayEngine()
     connect(&d->info.frameTimer, &QTimer::timeout, this, [=] () {
         d->info.video.setDelayedFrames(d->info.delayed);
         d->info.video.setDroppedFrames(d->mpv.get<int64_t>("vo-drop-frame-count"));
+        d->info.video.timing()->setStats(d->frames.timing.stats(50));
+        const auto q = d->mpv.frameStats();
+        d->info.video.setFrameQueue(q.dropped_late, q.dropped_full, q.queue_depth);
     });
     d->info.frameTimer.setInterval(100);
 
@@ -140,6 +162,8 @@ PlayEngine::PlayEngine()
     d->mpv.setOption("audio-file-auto", "no");
     d->mpv.setOption("sub-auto", "no");
     d->mpv.setOption("audio-client-name", cApp.name());
+    const auto mkvIndex = QString(_WritablePath(Location::Cache) % "/mkv-index"_a);
+    d->mpv.setOption("demuxer-mkv-index-cache-dir", mkvIndex.toLocal8Bit());
 
     auto overrides = qgetenv("BOMI_MPV_OPTIONS").trimmed();
     if (!overrides.isEmpty()) {
@@ -168,12 +192,15 @@ PlayEngine::PlayEngine()
     d->mpv.initialize();
     _Debug("Initialized");
     d->hook();
-    d->mpv.setUpdateCallback([=] ()
-        { d->vr->updateForNewFrame(d->info.video.renderer()->size()); });
+    d->mpv.setUpdateCallback([=] () {
+        d->frames.timing.stamp(FrameTimingRecorder::Queued);
+        d->vr->updateForNewFrame(d->info.video.renderer()->size());
+    });
 }
 
 PlayEngine::~PlayEngine()
 {
+    d->planner.waitForDone();
     d->params.m_mutex = nullptr;
     d->mpv.destroy();
     d->vr->setOverlay(nullptr);
@@ -188,13 +215,20 @@ PlayEngine::~PlayEngine()
 auto PlayEngine::initializeGL(QOpenGLContext *ctx) -> void
 {
     d->mpv.initializeGL(ctx);
+    d->frames.timing.initializeGL();
 }
 
 auto PlayEngine::finalizeGL(QOpenGLContext */*ctx*/) -> void
 {
+    d->frames.timing.finalizeGL();
     d->mpv.finalizeGL();
 }
 
+auto PlayEngine::saveFrameTimings(const QString &fileName) const -> bool
+{
+    return d->frames.timing.save(fileName);
+}
+
 auto PlayEngine::metaData() const -> const MetaData&
 {
     return d->metaData;
@@ -216,6 +250,11 @@ auto PlayEngine::cacheUsed() const -> int
     return d->cache.used;
 }
 
+auto PlayEngine::cache() const -> CacheObject*
+{
+    return &d->cache.stats;
+}
+
 auto PlayEngine::begin() const -> int
 {
     return d->begin;
@@ -256,6 +295,7 @@ auto PlayEngine::setAutoloader_locked(const Autoloader &audio, const Autoloader
 {
     d->streams[StreamAudio].autoloader = audio;
     d->streams[StreamSubtitle].autoloader = sub;
+    d->subLoader.setAutoloader(sub);
 }
 
 auto PlayEngine::setSubtitleInclusiveTrackSelected(int id, bool s) -> void
@@ -291,7 +331,7 @@ auto PlayEngine::autoloadSubtitleFiles() -> void
 
 auto PlayEngine::autoloadAudioFiles() -> void
 {
-    setAudioFiles(d->autoloadFiles(StreamAudio));
+    setAudioFiles(d->autoloadFiles(StreamAudio, d->mrl));
 }
 
 auto PlayEngine::reloadSubtitleFiles() -> void
@@ -364,6 +404,11 @@ auto PlayEngine::setSpeedPercent(int p) -> void
         d->mpv.setAsync("speed", speed());
 }
 
+auto PlayEngine::setSubtitleEffectsOnGpu_locked(bool gpu) -> void
+{
+    d->sr->setEffectsOnGpu(gpu);
+}
+
 auto PlayEngine::setSubtitleStyle_locked(const OsdStyle &style) -> void
 {
     d->sr->setStyle(style);
@@ -478,6 +523,11 @@ auto PlayEngine::screen() const -> QQuickItem*
     return d->vr;
 }
 
+auto PlayEngine::setDirectRendering(bool direct) -> void
+{
+    d->vr->setDirectRendering(direct);
+}
+
 auto PlayEngine::setCache_locked(const CacheInfo &info) -> void
 {
     d->params.d->cache = info;
@@ -600,6 +650,9 @@ auto PlayEngine::setAudioMuted(bool muted) -> void
 
 auto PlayEngine::shutdown() -> void
 {
+    d->urls.cancel();
+    d->planner.clear();
+    d->planner.waitForDone();
     d->mpv.tell("quit", 1);
 }
 
@@ -635,6 +688,25 @@ auto PlayEngine::load(const Mrl &mrl, bool tryResume) -> void
         d->loadfile(d->mrl, tryResume);
 }
 
+auto PlayEngine::prefetch(const Mrl &mrl) -> void
+{
+    const auto url = mrl.toString();
+    if (url.startsWith("http://"_a) || url.startsWith("https://"_a))
+        d->urls.prefetch(QUrl(url).toString(QUrl::FullyEncoded));
+    if (!mrl.isEmpty() && !mrl.isDisc())
+        prefetchStates({ mrl });
+}
+
+auto PlayEngine::prefetchStates(const QList<Mrl> &mrls) -> void
+{
+    if (d->history && !mrls.isEmpty()) {
+        d->planner.start(_Runnable([this, mrls] () {
+            QMutexLocker locker(&d->lookup);
+            d->history->prefetch(mrls);
+        }));
+    }
+}
+
 auto PlayEngine::time() const -> int
 {
     return d->time;
@@ -702,6 +774,9 @@ auto PlayEngine::setAudioTempoScaler(bool on) -> void
 
 auto PlayEngine::stop() -> void
 {
+    d->mutex.lock();
+    d->plan.reset(); // don't load after stopped
+    d->mutex.unlock();
     d->mpv.tell("stop");
 }
 
@@ -800,11 +875,13 @@ auto PlayEngine::audioDeviceList() const -> QList<AudioDevice>
 auto PlayEngine::setYle(YleDL *yle) -> void
 {
     d->yle = yle;
+    d->urls.setYleDL(yle);
 }
 
 auto PlayEngine::setYouTube(YouTubeDL *yt) -> void
 {
     d->youtube = yt;
+    d->urls.setYouTube(yt);
 }
 
 auto PlayEngine::setColorRange(ColorRange range) -> void
@@ -1045,6 +1122,7 @@ auto PlayEngine::setSubtitleEncoding_locked(const QString &enc, double accuracy)
 {
     d->params.d->subtitleEncoding = enc;
     d->params.d->autodetect = accuracy;
+    d->subLoader.setEncoding(enc, accuracy);
 }
 
 auto PlayEngine::setAutoselectMode_locked(bool enable, AutoselectMode mode,
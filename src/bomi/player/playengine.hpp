@@ -25,7 +25,7 @@ class YleDL;                            class AudioEqualizer;
 class StreamTrack;                      class SubtitleObject;
 class OpenGLFramebufferObject;          class SubtitleRenderer;
 class SubCompModel;                     class MrlState;
-class QOpenGLContext;
+class QOpenGLContext;                   class CacheObject;
 struct Autoloader;                      struct CacheInfo;
 struct IntrplParamSet;                  struct MotionIntrplOption;
 
@@ -59,6 +59,7 @@ class PlayEngine : public QObject {
 
     Q_PROPERTY(int cacheSize READ cacheSize NOTIFY cacheSizeChanged)
     Q_PROPERTY(int cacheUsed READ cacheUsed NOTIFY cacheUsedChanged)
+    Q_PROPERTY(CacheObject *cache READ cache CONSTANT FINAL)
     Q_PROPERTY(int avSync READ avSync NOTIFY avSyncChanged)
 
     Q_PROPERTY(State state READ state NOTIFY stateChanged)
@@ -107,6 +108,9 @@ public:
     auto speed() const -> double;
     auto state() const -> State;
     auto load(const Mrl &mrl, bool tryResume = true) -> void;
+    // resolves web page url and reads saved state in advance for next load()
+    auto prefetch(const Mrl &mrl) -> void;
+    auto prefetchStates(const QList<Mrl> &mrls) -> void;
     auto setMrl(const Mrl &mrl) -> void;
     auto editions() const -> const QVector<EditionPtr>&;
     auto edition() const -> EditionObject*;
@@ -141,6 +145,7 @@ public:
     auto lock() -> void;
     auto setHwAcc_locked(bool use, const QList<CodecId> &codecs) -> void;
     auto setSubtitleStyle_locked(const OsdStyle &style) -> void;
+    auto setSubtitleEffectsOnGpu_locked(bool gpu) -> void;
     auto setSubtitleEncoding_locked(const QString &enc, double accuracy) -> void;
     auto setAutoselectMode_locked(bool enable, AutoselectMode mode, const QString &ext) -> void;
     auto setCache_locked(const CacheInfo &info) -> void;
@@ -188,6 +193,9 @@ public:
     auto run() -> void;
     auto waitUntilTerminated() -> void;
     auto screen() const -> QQuickItem*;
+    auto setDirectRendering(bool direct) -> void;
+    // writes timings of recently rendered frames as csv
+    auto saveFrameTimings(const QString &fileName) const -> bool;
     auto media() const -> MediaObject*;
     auto audio() const -> AudioObject*;
     auto video() const -> VideoObject*;
@@ -197,6 +205,7 @@ public:
     auto setRate(qreal r) -> void { seek(begin() + r * duration()); }
     auto cacheSize() const -> int;
     auto cacheUsed() const -> int;
+    auto cache() const -> CacheObject*;
     auto setChannelLayout(ChannelLayout layout) -> void;
     auto chapterList() const -> QQmlListProperty<EditionChapterObject>;
     auto editionList() const -> QQmlListProperty<EditionChapterObject>;
@@ -1,4 +1,5 @@
 #include "playengine_p.hpp"
+#include "misc/startuptrace.hpp"
 
 template<class T>
 SIA findEnum(const QString &mpv) -> T
@@ -23,6 +24,8 @@ auto reg_play_engine() -> void
     qmlRegisterType<AvTrackObject>();
     qmlRegisterType<VideoFormatObject>();
     qmlRegisterType<VideoHwAccObject>();
+    qmlRegisterType<FrameTimingObject>();
+    qmlRegisterType<CacheObject>();
     qmlRegisterType<AudioFormatObject>();
     qmlRegisterType<AudioObject>();
     qmlRegisterType<CodecObject>();
@@ -144,6 +147,9 @@ auto PlayEngine::Data::videoSubOptions(const MrlState *s) const -> QByteArray
     else
         opts.add("frame-queue-size", 3);
     opts.add("frame-drop-mode", "clear"_b);
+    // queue only as deep as rendering jitter requires
+    opts.add("frame-queue-adaptive", true);
+    opts.add("frame-drop-late", true);
     opts.add("fancy-downscaling", s->video_hq_downscaling());
     opts.add("sigmoid-upscaling", s->video_hq_upscaling());
     opts.add("custom-shader", customShader(c_matrix()));
@@ -162,13 +168,102 @@ auto PlayEngine::Data::updateVideoSubOptions() -> void
 
 auto PlayEngine::Data::loadfile(const Mrl &mrl, bool resume) -> void
 {
-    QString file = mrl.isLocalFile() ? mrl.toLocalFile() : mrl.toString();
-    if (file.isEmpty())
+    auto plan = newPlan(mrl, resume);
+    if (plan->file.isEmpty())
         return;
-    OptionList opts;
-    opts.add("pause"_b, p->isPaused() || hasImage);
-    opts.add("resume-playback", resume);
-    mpv.tell("loadfile"_b, file.toLocal8Bit(), "replace"_b, opts.get());
+    mutex.lock();
+    const auto old = this->plan;
+    this->plan = plan;
+    mutex.unlock();
+    if (old && old->remaining.load() > 0)
+        urls.cancel();
+    // history, autoloading and stream resolution run in parallel;
+    // loadfile is sent by LoadPlanReady
+    const bool network = plan->file.startsWith("http://"_a)
+                         || plan->file.startsWith("https://"_a);
+    plan->remaining = network ? 2 : 1;
+    auto done = [=] () {
+        if (!plan->remaining.deref())
+            _PostEvent(p, LoadPlanReady, plan);
+    };
+    subLoader.request(plan->mrl);
+    planner.start(_Runnable([=] () { planState(plan.data()); done(); }));
+    if (network)
+        planner.start(_Runnable([=] () { planStream(plan.data()); done(); }));
+}
+
+auto PlayEngine::Data::newPlan(const Mrl &mrl, bool resume) -> QSharedPointer<LoadPlan>
+{
+    auto plan = QSharedPointer<LoadPlan>::create();
+    plan->mrl = mrl;
+    plan->file = mrl.isLocalFile() ? mrl.toLocalFile() : mrl.toString();
+    plan->pause = p->isPaused() || hasImage;
+    mutex.lock();
+    plan->reload = this->reload;
+    this->reload = -1;
+    plan->resume = resume && this->resume;
+    mutex.unlock();
+    return plan;
+}
+
+auto PlayEngine::Data::planState(LoadPlan *plan) -> void
+{
+    plan->local = localCopy();
+    auto local = plan->local.data();
+
+    Mrl mrl(plan->file);
+    local->set_mrl(mrl.toUnique());
+    local->d->disc = mrl.isDisc();
+
+    if (plan->reload < 0) {
+        local->set_resume_position(-1);
+        local->set_edition(-1);
+        local->set_device(QString());
+        local->set_video_tracks(StreamList());
+        local->set_audio_tracks(StreamList());
+        local->set_sub_tracks(StreamList());
+        local->set_sub_tracks_inclusive(StreamList());
+        lookup.lock();
+        plan->found = history->getState(local);
+        lookup.unlock();
+    } else {
+        local->set_resume_position(plan->reload);
+        local->set_device(mrl.device());
+        plan->resume = plan->found = true;
+    }
+
+    if (!plan->found || !local->audio_tracks().isValid()) {
+        QMutexLocker locker(&mutex);
+        plan->audioFiles = autoloadFiles(StreamAudio, mrl);
+    }
+    // never wait for slow directory, charset detection or parsing;
+    // onLoad() takes late result or lets it be delivered
+    if (plan->found && local->sub_tracks().isValid()) {
+        const auto tracks = local->sub_tracks_inclusive();
+        if (tracks.isEmpty())
+            plan->subReady = true;
+        else {
+            subLoader.restore(mrl, tracks);
+            plan->subReady = subLoader.take(mrl, &plan->subs);
+        }
+    } else
+        plan->subReady = subLoader.take(mrl, &plan->subs);
+}
+
+auto PlayEngine::Data::planStream(LoadPlan *plan) -> void
+{
+    auto &s = plan->stream;
+    const auto file = QUrl(plan->file).toString(QUrl::FullyEncoded);
+    UrlResolver::Result r;
+    if (urls.resolve(file, &r)) {
+        s.url = r.url;
+        s.title = r.title;
+        s.cookies = !r.cookies.isEmpty();
+        s.cookiesFile = r.cookies;
+        s.userAgent = r.userAgent;
+    } else
+        s.url = file;
+    s.resolved = true;
 }
 
 auto PlayEngine::Data::updateMediaName(const QString &name) -> void
@@ -189,34 +284,22 @@ auto PlayEngine::Data::updateMediaName(const QString &name) -> void
 auto PlayEngine::Data::onLoad() -> void
 {
     auto file = mpv.get<QString>("stream-open-filename");
-    t.local = localCopy();
-    auto local = t.local.data();
-
-    Mrl mrl(file);
-    local->set_mrl(mrl.toUnique());
-    local->d->disc = mrl.isDisc();
 
     mutex.lock();
-    auto reload = this->reload;
-    this->reload = -1;
+    auto plan = this->plan;
+    this->plan.reset();
     mutex.unlock();
-
-    bool found = false, resume = false;
-    if (reload < 0) {
-        local->set_resume_position(-1);
-        local->set_edition(-1);
-        local->set_device(QString());
-        local->set_video_tracks(StreamList());
-        local->set_audio_tracks(StreamList());
-        local->set_sub_tracks(StreamList());
-        local->set_sub_tracks_inclusive(StreamList());
-        found = history->getState(local);
-        resume = mpv.get<bool>("options/resume-playback") && this->resume;
-    } else {
-        local->set_resume_position(reload);
-        local->set_device(mrl.device());
-        resume = found = true;
+    if (!plan || plan->file != file || plan->remaining.load() > 0) {
+        // not loaded by loadfile(): prepare everything here
+        plan = newPlan(Mrl(file), mpv.get<bool>("options/resume-playback"));
+        planState(plan.data());
+        if (file.startsWith("http://"_a) || file.startsWith("https://"_a))
+            planStream(plan.data());
     }
+    t.local = plan->local;
+    auto local = t.local.data();
+    Mrl mrl(file);
+    const bool found = plan->found, resume = plan->resume;
 
     auto setFiles = [&] (QByteArray &&name, QByteArray &&nid,
             const StreamList &list) {
@@ -237,23 +320,29 @@ auto PlayEngine::Data::onLoad() -> void
 
     if (found && local->audio_tracks().isValid())
         setFiles("file-local-options/audio-file"_b, "file-local-options/aid"_b, local->audio_tracks());
-    else {
-        QMutexLocker locker(&mutex);
-        mpv.setAsync("file-local-options/audio-file", autoloadFiles(StreamAudio));
-    }
+    else
+        mpv.setAsync("file-local-options/audio-file", plan->audioFiles);
     QVector<SubComp> loads;
+    bool subPending = false;
     if (found && local->sub_tracks().isValid()) {
         setFiles("file-local-options/sub-file"_b, "file-local-options/sid"_b, local->sub_tracks());
-        loads = restoreInclusiveSubtitles(local->sub_tracks_inclusive());
-    } else {
+        if (plan->subReady || subLoader.take(mrl, &plan->subs))
+            loads = std::move(plan->subs.components);
+        else // will be restored by SubtitleAutoloaded
+            subPending = true;
+    } else if (plan->subReady || subLoader.take(mrl, &plan->subs)) {
+        auto &result = plan->subs;
         QMutexLocker locker(&mutex);
-        QStringList files, encs;
-        _R(files, loads) = autoloadSubtitle(local);
-        if (!files.isEmpty()) {
-            mpv.setAsync("options/subcp", assEncodings[files.front()].toLatin1());
-            mpv.setAsync("file-local-options/sub-file", files);
+        for (auto it = result.encodings.cbegin(); it != result.encodings.cend(); ++it)
+            assEncodings[it.key()] = *it;
+        loads = std::move(result.components);
+        autoselect(local, loads);
+        if (!result.files.isEmpty()) {
+            mpv.setAsync("options/subcp", assEncodings[result.files.front()].toLatin1());
+            mpv.setAsync("file-local-options/sub-file", result.files);
         }
-    }
+    } else // will be added by SubtitleAutoloaded
+        subPending = true;
 
     local->set_last_played_date_time(QDateTime::currentDateTime());
     local->set_device(mrl.device());
@@ -300,29 +389,34 @@ auto PlayEngine::Data::onLoad() -> void
         mpv.setAsync("file-local-options/cache", cache);
         mpv.setAsync("file-local-options/cache-initial", local->d->cache.playback(cache));
         mpv.setAsync("file-local-options/cache-seek-min", local->d->cache.seeking(cache));
+        if (local->d->cache.isRemote(mrl))
+            mpv.setAsync("file-local-options/cache-connections", local->d->cache.connections);
+        if (local->d->cache.persistent(mrl)) {
+            const auto disk = local->d->cache.disk;
+            mpv.setAsync("file-local-options/cache-dir", local->d->cache.dir.toLocal8Bit());
+            mpv.setAsync("file-local-options/cache-dir-size", disk);
+            mpv.setAsync("file-local-options/cache-file-size", disk);
+        }
     } else
         mpv.setAsync("file-local-options/cache", "no"_b);
 
 
-    if (file.startsWith("http://"_a) || file.startsWith("https://"_a)) {
-        file = QUrl(file).toString(QUrl::FullyEncoded);
-        if (yle && yle->supports(file)) {
-            if (yle->run(file))
-                mpv.setAsync("stream-open-filename", yle->url().toLocal8Bit());
-        } else if (youtube && youtube->run(file)) {
+    const auto &stream = plan->stream;
+    if (stream.resolved) {
+        if (stream.cookies) {
             mpv.setAsync("file-local-options/cookies", true);
-            mpv.setAsync("file-local-options/cookies-file", youtube->cookies().toLocal8Bit());
-            mpv.setAsync("file-local-options/user-agent", youtube->userAgent().toLocal8Bit());
-            const auto r = youtube->result();
-            if (!r.url.isEmpty())
-                mpv.setAsync("stream-open-filename", r.url.toLocal8Bit());
-            if (!r.title.isEmpty())
-                mpv.setAsync("file-local-options/media-title", r.title.toLocal8Bit());
-        } else
-            mpv.setAsync("stream-open-filename", file.toLocal8Bit());
+            mpv.setAsync("file-local-options/cookies-file", stream.cookiesFile.toLocal8Bit());
+            mpv.setAsync("file-local-options/user-agent", stream.userAgent.toLocal8Bit());
+        }
+        if (!stream.url.isEmpty())
+            mpv.setAsync("stream-open-filename", stream.url.toLocal8Bit());
+        if (!stream.title.isEmpty())
+            mpv.setAsync("file-local-options/media-title", stream.title.toLocal8Bit());
     }
     mpv.flush();
     _PostEvent(p, SyncMrlState, t.local, loads);
+    if (subPending)
+        subLoader.deliver(mrl, p, SubtitleAutoloaded);
     t.local.clear();
 }
 
@@ -349,10 +443,26 @@ auto PlayEngine::Data::observe() -> void
     mpv.observeState("paused-for-cache", [=] (bool b) { post(Buffering, b); });
     mpv.observeState("seeking", [=] (bool s) { post(Seeking, s); });
 
-    mpv.observe("cache-used", [=] () { return t.caching ? mpv.get<int>("cache-used") : 0; },
+    const auto cacheUsed = mpv.observe("cache-used", [=] (int used) { return t.caching ? used : 0; },
                 [=] (int v) { if (_Change(cache.used, v)) emit p->cacheUsedChanged(); });
-    mpv.observe("cache-size", [=] () { return t.caching ? mpv.get<int>("cache-size") : 0; },
+    mpv.setThrottle(cacheUsed, 250);
+    mpv.observe("cache-size", [=] (int size) { return t.caching ? size : 0; },
                 [=] (int v) { if (_Change(cache.size, v)) emit p->cacheSizeChanged(); });
+    const auto cacheStats = mpv.observe("cache-stats", [=] (QVariant &&v) {
+        auto &stats = cache.stats;
+        stats.setStats(v.toMap());
+        if (stats.bytesIn() <= 0)
+            return;
+        if (cache.logged.isValid() && !cache.logged.hasExpired(CacheLogInterval))
+            return;
+        cache.logged.start();
+        _Debug("Cache: in %%KiB/s, out %%KiB/s, seeks %% cached/%% missed, "
+               "%% underrun(s), %%s waited", qRound(stats.inRate() / 1024),
+               qRound(stats.outRate() / 1024), stats.seeksCached(),
+               stats.seeksMissed(), stats.underruns(),
+               QString::number(stats.waitTime(), 'f', 1));
+    });
+    mpv.setThrottle(cacheStats, 1000);
     mpv.observe("seekable", seekable, [=] () { emit p->seekableChanged(seekable); });
 
     auto updateChapter = [=] (int n) {
@@ -365,7 +475,8 @@ auto PlayEngine::Data::observe() -> void
         emit p->chapterChanged();
     };
 
-    mpv.observeTime("avsync", avSync, [=] () { emit p->avSyncChanged(avSync); });
+    const auto avsync = mpv.observeTime("avsync", avSync, [=] () { emit p->avSyncChanged(avSync); });
+    mpv.setThrottle(avsync, 100);
     mpv.observeTime("time-pos", time, [=] () {
         emit p->tick(time);
         if (_Change(time_s, time/1000))
@@ -385,8 +496,8 @@ auto PlayEngine::Data::observe() -> void
         updateChapter(mpv.get<int>("chapter"));
     });
 
-    mpv.observe("chapter-list", [=] () {
-        const auto array = mpv.get<QVariant>("chapter-list").toList();
+    mpv.observe("chapter-list", [=] (QVariant &&var) {
+        const auto array = var.toList();
         QVector<ChapterData> data(array.size());
         for (int i=0; i<array.size(); ++i) {
             const auto map = array[i].toMap();
@@ -410,9 +521,7 @@ auto PlayEngine::Data::observe() -> void
         tmp.clear();
     });
     mpv.observe("chapter", updateChapter);
-    mpv.observe("track-list", [=] () {
-        return toTracks(mpv.get<QVariant>("track-list"));
-    }, [=] (auto &&strms) {
+    mpv.observe("track-list", [=] (QVariant &&var) { return toTracks(var); }, [=] (auto &&strms) {
         params.set_video_tracks(strms[StreamVideo]);
         params.set_audio_tracks(strms[StreamAudio]);
         params.set_sub_tracks(strms[StreamSubtitle]);
@@ -420,8 +529,8 @@ auto PlayEngine::Data::observe() -> void
 
     for (auto type : streamTypes)
         mpv.observe(streams[type].pid, [=] (int id) { params.select(type, id); });
-    mpv.observe("metadata", [=] () {
-        const auto list = mpv.get<QVariant>("metadata").toList();
+    mpv.observe("metadata", [=] (QVariant &&var) {
+        const auto list = var.toList();
         MetaData metaData;
         for (int i=0; i+1<list.size(); i+=2) {
             const auto key = list[i].toString();
@@ -462,7 +571,8 @@ auto PlayEngine::Data::observe() -> void
         input->setHeight(h);
         input->setBppSize(input->size());
     });
-    mpv.observe("video-bitrate", [=] (int bps) { info.video.input()->setBitrate(bps); });
+    const auto vbps = mpv.observe("video-bitrate", [=] (int bps) { info.video.input()->setBitrate(bps); });
+    mpv.setThrottle(vbps, 500);
     mpv.observe("video-format", [=] (QString &&f) { info.video.input()->setType(f); });
     QRegularExpression rx(uR"(Video decoder: ([^\n]*))"_q);
     auto decoderOutput = [=] (const char *name) -> QString {
@@ -516,7 +626,8 @@ auto PlayEngine::Data::observe() -> void
 
     mpv.observe("audio-codec", [=] (QString &&c) { info.audio.codec()->parse(c); });
     mpv.observe("audio-format", [=] (QString &&f) { info.audio.input()->setType(f); });
-    mpv.observe("audio-bitrate", [=] (int bps) { info.audio.input()->setBitrate(bps); });
+    const auto abps = mpv.observe("audio-bitrate", [=] (int bps) { info.audio.input()->setBitrate(bps); });
+    mpv.setThrottle(abps, 500);
     mpv.observe("audio-samplerate", [=] (int s) { info.audio.input()->setSampleRate(s, false); });
     mpv.observe("audio-channels", [=] (int n)
         { info.audio.input()->setChannels(QString::number(n) % "ch"_a, n); });
@@ -636,7 +747,7 @@ auto PlayEngine::Data::process(QEvent *event) -> void
             break;
         }
         updateState(state);
-        history->update(last.data(), false);
+        history->update(last.data());
         emit p->finished(last->mrl(), eof);
         break;
     } case NotifySeek:
@@ -653,7 +764,25 @@ auto PlayEngine::Data::process(QEvent *event) -> void
         params.set_sub_tracks_inclusive(sr->toTrackList());
         mutex.unlock();
         params.m_mutex = &mutex;
-        history->update(&params, true);
+        history->update(&params);
+        break;
+    } case LoadPlanReady: {
+        const auto plan = _MoveData<QSharedPointer<LoadPlan>>(event);
+        mutex.lock();
+        const bool current = this->plan == plan;
+        mutex.unlock();
+        if (!current)
+            break;
+        OptionList opts;
+        opts.add("pause"_b, plan->pause);
+        opts.add("resume-playback", plan->resume);
+        mpv.tell("loadfile"_b, plan->file.toLocal8Bit(), "replace"_b, opts.get());
+        break;
+    } case SubtitleAutoloaded: {
+        QString file; SubtitleAutoloader::Result result;
+        _TakeData(event, file, result);
+        if (file == mrl.toLocalFile())
+            addAutoloadedSubtitles(std::move(result));
         break;
     } default:
         break;
@@ -694,8 +823,12 @@ auto PlayEngine::Data::takeSnapshot() -> void
 
 auto PlayEngine::Data::renderVideoFrame(OpenGLFramebufferObject *fbo) -> void
 {
+    frames.timing.beginRender();
     info.delayed = mpv.render(fbo->id(), fbo->size());
+    frames.timing.endRender(info.delayed);
     frames.measure.push(++frames.drawn);
+    if (frames.drawn == 1)
+        StartupTrace::finish("first video frame");
 
     _Trace("PlayEngine::Data::renderVideoFrame(): "
            "render queued frame(%%), avgfps: %%",
@@ -707,6 +840,31 @@ auto PlayEngine::Data::renderVideoFrame(OpenGLFramebufferObject *fbo) -> void
     }
 }
 
+auto PlayEngine::Data::renderVideoDirect(GLuint fbo, const QRect &vp,
+                                         bool flip, bool redraw) -> void
+{
+    // window is cleared for every frame so mpv should draw again anyway
+    if (!redraw) {
+        info.delayed = mpv.render(fbo, vp, flip);
+        return;
+    }
+    frames.timing.beginRender();
+    info.delayed = mpv.render(fbo, vp, flip);
+    frames.timing.endRender(info.delayed);
+    frames.measure.push(++frames.drawn);
+    if (frames.drawn == 1)
+        StartupTrace::finish("first video frame");
+
+    _Trace("PlayEngine::Data::renderVideoDirect(): "
+           "render queued frame(%%), avgfps: %%",
+           vp, info.video.renderer()->fps());
+
+    if (snapshot) {
+        this->takeSnapshot();
+        snapshot = NoSnapshot;
+    }
+}
+
 auto PlayEngine::Data::toTracks(const QVariant &var) -> QVector<StreamList>
 {
     QVector<StreamList> streams(3);
@@ -753,7 +911,7 @@ auto PlayEngine::Data::restoreInclusiveSubtitles(const StreamList &tracks) -> QV
     return ret;
 }
 
-auto PlayEngine::Data::autoloadFiles(StreamType type) -> QStringList
+auto PlayEngine::Data::autoloadFiles(StreamType type, const Mrl &mrl) -> QStringList
 {
     auto &a = streams[type].autoloader;
     if (a.enabled)
@@ -809,22 +967,23 @@ auto PlayEngine::Data::autoselect(const MrlState *s, QVector<SubComp> &loads) ->
 
 auto PlayEngine::Data::autoloadSubtitle(const MrlState *s) -> T<QStringList, QVector<SubComp>>
 {
-    const auto subs = autoloadFiles(StreamSubtitle);
-    QStringList files;
-    QVector<SubComp> loads;
-    for (auto &file : subs) {
-        const auto enc = s->d->detect(file);
-        Subtitle sub;
-        if (sub.load(file, enc, -1)) {
-            for (int i = 0; i < sub.size(); ++i)
-                loads.push_back(sub[i]);
-        } else {
-            files.push_back(file);
-            assEncodings[file] = enc;
-        }
-    }
-    autoselect(s, loads);
-    return _T(files, loads);
+    auto result = subLoader.load(mrl);
+    for (auto it = result.encodings.cbegin(); it != result.encodings.cend(); ++it)
+        assEncodings[it.key()] = *it;
+    autoselect(s, result.components);
+    return _T(result.files, result.components);
+}
+
+auto PlayEngine::Data::addAutoloadedSubtitles(SubtitleAutoloader::Result &&result) -> void
+{
+    for (auto &file : result.files)
+        sub_add(file, result.encodings[file], false);
+    if (result.components.isEmpty())
+        return;
+    if (!result.restored)
+        autoselect(&params, result.components);
+    sr->addComponents(result.components);
+    syncInclusiveSubtitles();
 }
 
 auto PlayEngine::Data::localCopy() -> QSharedPointer<MrlState>
@@ -874,6 +1033,7 @@ auto PlayEngine::Data::setWaitings(Waitings w, bool set) -> void
 auto PlayEngine::Data::clearTimings() -> void
 {
     frames.measure.reset();
+    frames.timing.clear();
     info.video.setDroppedFrames(0);
     info.video.setDelayedFrames(0);
     info.video.renderer()->setFps(0);
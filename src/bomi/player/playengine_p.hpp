@@ -16,16 +16,20 @@
 #include "misc/osdstyle.hpp"
 #include "misc/speedmeasure.hpp"
 #include "misc/yledl.hpp"
+#include "misc/urlresolver.hpp"
 #include "misc/charsetdetector.hpp"
+#include "misc/runnable.hpp"
 #include "audio/audiocontroller.hpp"
 #include "audio/audioformat.hpp"
 #include "video/deintoption.hpp"
 #include "video/videorenderer.hpp"
 #include "video/videoprocessor.hpp"
+#include "video/frametimingrecorder.hpp"
 #include "video/videocolor.hpp"
 #include "video/interpolatorparams.hpp"
 #include "subtitle/subtitle.hpp"
 #include "subtitle/subtitlerenderer.hpp"
+#include "subtitle/subtitleautoloader.hpp"
 #include "enum/deintmode.hpp"
 #include "enum/colorspace.hpp"
 #include "enum/colorrange.hpp"
@@ -37,6 +41,7 @@
 #include "enum/codecid.hpp"
 #include "opengl/openglframebufferobject.hpp"
 #include "os/os.hpp"
+#include <QThreadPool>
 
 #ifdef bool
 #undef bool
@@ -47,13 +52,15 @@ DECLARE_LOG_CONTEXT(Engine)
 enum EventType {
     UserType = QEvent::User, StateChange, WaitingChange,
     PreparePlayback,EndPlayback, StartPlayback, NotifySeek,
-    SyncMrlState,
+    SyncMrlState, SubtitleAutoloaded, LoadPlanReady,
     EventTypeMax
 };
 
 static const QVector<StreamType> streamTypes
     = { StreamAudio, StreamVideo, StreamSubtitle };
 
+static const int CacheLogInterval = 10000; // msec
+
 struct StreamData {
     StreamData() = default;
     StreamData(const char *pid, ExtType ext)
@@ -65,6 +72,24 @@ struct StreamData {
     Autoloader autoloader;
 };
 
+// Everything on_load hook needs to know, prepared on worker threads before
+// loadfile command is sent so that the hook only applies options.
+struct LoadPlan {
+    Mrl mrl;
+    QString file; // same as stream-open-filename
+    int reload = -1;
+    bool resume = false, found = false, pause = false;
+    QSharedPointer<MrlState> local;
+    QStringList audioFiles;
+    bool subReady = false;
+    SubtitleAutoloader::Result subs;
+    struct {
+        bool resolved = false, cookies = false;
+        QString url, title, cookiesFile, userAgent;
+    } stream;
+    QAtomicInt remaining;
+};
+
 struct PlayEngine::Data {
     Data(PlayEngine *engine);
     PlayEngine *p = nullptr;
@@ -111,13 +136,22 @@ struct PlayEngine::Data {
 
     QByteArray hwcdc;
 
-    struct { int size = 0, used = 0; } cache;
+    struct {
+        int size = 0, used = 0;
+        CacheObject stats;
+        QElapsedTimer logged;
+    } cache;
 
     int avSync = 0, reload = -1;
     int time_s = 0, begin_s = 0, end_s = 0, duration_s = 0;
     int duration = 0, begin = 0, time = 0;
 
     QMap<QString, QString> assEncodings;
+    SubtitleAutoloader subLoader;
+    QThreadPool planner;
+    QMutex lookup; // for history from planner threads
+    UrlResolver urls;
+    QSharedPointer<LoadPlan> plan; // latest one, guarded by mutex
 
     std::array<StreamData, StreamUnknown> streams = []() {
         std::array<StreamData, StreamUnknown> strs;
@@ -131,6 +165,8 @@ struct PlayEngine::Data {
     struct {
         quint64 drawn = 0, dropped = 0, delayed = 0;
         SpeedMeasure<quint64> measure{5, 20};
+        FrameTimingRecorder timing;
+        QMetaObject::Connection swapped, screen; // of current window
     } frames;
 
     struct { QImage screen, video; } ss;
@@ -151,8 +187,9 @@ struct PlayEngine::Data {
         { mpv.tellAsync("audio_add", file.toLocal8Bit(), select ? "select"_b : "auto"_b); }
     auto sub_add(const QString &file, const QString &enc, bool select) -> void;
     auto autoselect(const MrlState *s, QVector<SubComp> &loads) -> void;
-    auto autoloadFiles(StreamType type) -> QStringList;
+    auto autoloadFiles(StreamType type, const Mrl &mrl) -> QStringList;
     auto autoloadSubtitle(const MrlState *s) -> T<QStringList, QVector<SubComp>>;
+    auto addAutoloadedSubtitles(SubtitleAutoloader::Result &&result) -> void;
 
     auto af(const MrlState *s) const -> QByteArray;
     auto vf(const MrlState *s) const -> QByteArray;
@@ -160,6 +197,7 @@ struct PlayEngine::Data {
     auto videoSubOptions(const MrlState *s) const -> QByteArray;
     auto updateVideoSubOptions() -> void;
     auto renderVideoFrame(OpenGLFramebufferObject *fbo) -> void;
+    auto renderVideoDirect(GLuint fbo, const QRect &vp, bool flip, bool redraw) -> void;
     auto displaySize() const { return info.video.renderer()->size(); }
     auto post(State state) -> void { _PostEvent(p, StateChange, state); }
     auto post(Waitings w, bool set) -> void { _PostEvent(p, WaitingChange, w, set); }
@@ -168,6 +206,9 @@ struct PlayEngine::Data {
         { return s->audio_volume() * s->audio_amplifier() * 1e-3; }
 
     auto loadfile(const Mrl &mrl, bool resume) -> void;
+    auto newPlan(const Mrl &mrl, bool resume) -> QSharedPointer<LoadPlan>;
+    auto planState(LoadPlan *plan) -> void;
+    auto planStream(LoadPlan *plan) -> void;
     auto updateMediaName(const QString &name = QString()) -> void;
 
     auto toTracks(const QVariant &var) -> QVector<StreamList>;
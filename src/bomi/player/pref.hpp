@@ -103,6 +103,7 @@ public:
     P0(int, sub_enc_accuracy, defaultSubtitleEncodingDetectionAccuracy())
     P0(int, ms_per_char, 500)
     P0(OsdStyle, sub_style, {})
+    P0(bool, sub_gpu_effects, false)
 
     P0(bool, enable_system_tray, true)
     P0(bool, hide_rather_close, true)
@@ -124,6 +125,7 @@ public:
     P0(int, sub_pos_step, 1)
     P0(bool, enable_hwaccel, false)
     P0(QList<CodecId>, hwaccel_codecs, OS::hwAcc()->fullCodecList())
+    P0(bool, video_direct_rendering, false)
     P0(DeintOptionSet, deinterlacing, {})
 
     P0(AudioNormalizerOption, audio_normalizer, AudioNormalizerOption::default_())
@@ -138,9 +140,12 @@ public:
     P0(int, cache_local, 0)
     P0(int, cache_network, 25000)
     P0(int, cache_disc, 0)
+    P0(int, cache_connections, 4)
     P0(int, cache_min_playback, 0)
     P0(int, cache_min_seeking, 2)
     P0(QStringList, network_folders, {})
+    P0(bool, cache_disk, false)
+    P0(int, cache_disk_size, 2048)
 
     P0(QString, yt_user_agent, u"Mozilla/5.0 (X11; Linux x86_64; rv:10.0) Gecko/20100101 Firefox/10.0 (Chrome)"_q)
     P0(QString, yt_program, u"youtube-dl"_q)
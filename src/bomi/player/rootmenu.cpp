@@ -571,6 +571,7 @@ RootMenu::RootMenu()
         d->action(u"subtitle"_q, QT_TR_NOOP("Subtitle View"));
         d->action(u"playinfo"_q, QT_TR_NOOP("Playback Information"));
         d->action(u"log"_q, QT_TR_NOOP("Log Viewer"));
+        d->action(u"frame-timing"_q, QT_TR_NOOP("Export Frame Timings"));
         d->separator();
 
         d->action(u"pref"_q, QT_TR_NOOP("Preferences"))->setMenuRole(QAction::PreferencesRole);
@@ -45,6 +45,30 @@ struct RichTextBlock::Ruby {
     RichTextBlock rt_block;
 };
 
+inline auto operator == (const RichTextBlock::Format &lhs,
+                         const RichTextBlock::Format &rhs) -> bool
+{
+    return lhs.begin == rhs.begin && lhs.end == rhs.end
+            && lhs.style == rhs.style;
+}
+
+inline auto operator == (const RichTextBlock &lhs,
+                         const RichTextBlock &rhs) -> bool;
+
+inline auto operator == (const RichTextBlock::Ruby &lhs,
+                         const RichTextBlock::Ruby &rhs) -> bool
+{
+    return lhs.rb_begin == rhs.rb_begin && lhs.rb_end == rhs.rb_end
+            && lhs.rt_block == rhs.rt_block;
+}
+
+inline auto operator == (const RichTextBlock &lhs,
+                         const RichTextBlock &rhs) -> bool
+{
+    return lhs.paragraph == rhs.paragraph && lhs.text == rhs.text
+            && lhs.formats == rhs.formats && lhs.rubies == rhs.rubies;
+}
+
 class RichTextBlockParser : public RichTextHelper {
 public:
     RichTextBlockParser(const QStringRef &text);
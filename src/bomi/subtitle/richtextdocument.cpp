@@ -142,8 +142,10 @@ static const QTextOption rubyOption = makeRubyOption();
 
 auto RichTextDocument::doLayout(double maxWidth) -> void
 {
-    if (!m_dirty)
+    if (!m_dirty && m_width == maxWidth)
         return;
+    m_width = maxWidth;
+    m_glyphs = QPainterPath();
     double width = -1;
     const int px = m_format.intProperty(QTextFormat::FontPixelSize);
     m_boxes.clear();
@@ -297,6 +299,35 @@ auto RichTextDocument::draw(QPainter *painter, const QPointF &pos) -> void
     }
 }
 
+auto RichTextDocument::drawOutline(QPainter *painter, const QPointF &pos,
+                                   const QPen &pen) -> void
+{
+    if (m_glyphs.isEmpty()) {
+        auto add = [this] (const QTextLayout &layout) {
+            for (const auto &run : layout.glyphRuns()) {
+                const auto font = run.rawFont();
+                const auto indexes = run.glyphIndexes();
+                const auto positions = run.positions();
+                for (int i = 0; i < indexes.size(); ++i) {
+                    auto path = font.pathForGlyph(indexes[i]);
+                    m_glyphs.addPath(path.translated(positions[i]));
+                }
+            }
+        };
+        for (auto layout : m_layouts) {
+            add(layout->block);
+            for (auto ruby : layout->rubies)
+                add(*ruby);
+        }
+    }
+    painter->save();
+    painter->translate(pos);
+    painter->setPen(pen);
+    painter->setBrush(Qt::NoBrush);
+    painter->drawPath(m_glyphs);
+    painter->restore();
+}
+
 auto RichTextDocument::drawBoudingBoxes(QPainter *painter,
                                         const QPointF &pos) -> void
 {
@@ -306,3 +337,30 @@ auto RichTextDocument::drawBoudingBoxes(QPainter *painter,
     painter->drawRects(m_boxes);
     painter->restore();
 }
+
+/******************************************************************************/
+
+auto RichTextLayoutCache::get(const RichTextDocument &base,
+                              const RichTextDocument &text) -> RichTextDocument&
+{
+    const auto &blocks = text.blocks();
+    uint hash = 0;
+    for (auto &block : blocks)
+        hash ^= qHash(block.text);
+    for (auto it = m_entries.begin(); it != m_entries.end(); ++it) {
+        if (it->hash == hash && it->blocks == blocks) {
+            if (it != m_entries.begin())
+                m_entries.splice(m_entries.begin(), m_entries, it);
+            return m_entries.front().doc;
+        }
+    }
+    while ((int)m_entries.size() >= m_capacity && !m_entries.empty())
+        m_entries.pop_back();
+    m_entries.emplace_front();
+    auto &entry = m_entries.front();
+    entry.hash = hash;
+    entry.blocks = blocks;
+    entry.doc = base;
+    entry.doc += text;
+    return entry.doc;
+}
@@ -4,6 +4,7 @@
 #include "richtextblock.hpp"
 #include "richtexthelper.hpp"
 #include <QTextLayout>
+#include <list>
 
 class RichTextDocument : public RichTextHelper {
 public:
@@ -40,6 +41,9 @@ public:
     auto setWrapMode(QTextOption::WrapMode wrapMode) -> void;
     auto setFormat(QTextFormat::Property property, const QVariant &data) -> void;
     auto draw(QPainter *painter, const QPointF &pos) -> void;
+    // strokes glyph runs of current layout; no second layout for outline
+    auto drawOutline(QPainter *painter, const QPointF &pos,
+                     const QPen &pen) -> void;
     auto drawBoudingBoxes(QPainter *painter, const QPointF &pos) -> void;
     auto doLayout(double maxWidth) -> void;
     auto updateLayoutInfo() -> void;
@@ -49,7 +53,8 @@ public:
     auto setTextOutline(const QPen &pen) -> void;
     auto naturalSize() const -> QSizeF {return m_natural.size();}
     auto setLeading(double newLine, double paragraph) -> void;
-    auto clear() -> void { freeLayouts(); m_blocks.clear(); setChanged(true); }
+    auto clear() -> void
+        { freeLayouts(); m_blocks.clear(); m_glyphs = {}; setChanged(true); }
     const QVector<QRectF> &boundingBoxes() const { return m_boxes; }
 private:
     struct Layout {
@@ -69,6 +74,32 @@ private:
     QVector<Layout*> m_layouts;
     bool m_blockChanged, m_formatChanged, m_optionChanged, m_pxChanged, m_dirty;
     QRectF m_natural;
+    double m_width = -1;
+    QPainterPath m_glyphs;
+};
+
+// Keeps laid-out documents for recent texts so that same caption is shaped
+// only once and later layouts with new width only break lines again.
+// Entries are not shared by copies since QTextLayout is not thread-safe.
+class RichTextLayoutCache {
+public:
+    RichTextLayoutCache(int capacity = 8): m_capacity(capacity) { }
+    RichTextLayoutCache(const RichTextLayoutCache &rhs)
+        : m_capacity(rhs.m_capacity) { }
+    auto operator = (const RichTextLayoutCache &rhs) -> RichTextLayoutCache&
+        { if (this != &rhs) { clear(); m_capacity = rhs.m_capacity; } return *this; }
+    // returns base merged with text; valid until next call or clear()
+    auto get(const RichTextDocument &base,
+             const RichTextDocument &text) -> RichTextDocument&;
+    auto clear() -> void { m_entries.clear(); }
+private:
+    struct Entry {
+        uint hash = 0;
+        QList<RichTextBlock> blocks;
+        RichTextDocument doc;
+    };
+    int m_capacity = 8;
+    std::list<Entry> m_entries;
 };
 
 #endif // RICHTEXTDOCUMENT_HPP
@@ -1,5 +1,6 @@
 #include "subtitle.hpp"
 #include "subtitle_parser.hpp"
+#include "subtitlecache.hpp"
 #include "misc/charsetdetector.hpp"
 #include "player/streamtrack.hpp"
 
@@ -33,6 +34,12 @@ SubComp::SubComp(SubType type, const QFileInfo &file, const QString &enc, int id
     m_capts[0].index = 0;
 }
 
+auto SubComp::newId() -> int
+{
+    static QAtomicInt id;
+    return id.fetchAndAddOrdered(1);
+}
+
 auto SubComp::toTrack() const -> StreamTrack
 {
     return StreamTrack::fromSubComp(*this);
@@ -142,7 +149,12 @@ auto Subtitle::load(const QString &file, const QString &enc, double acc) -> bool
 
 auto Subtitle::parse(const QString &file, const QString &enc) -> Subtitle
 {
-    return SubtitleParser::parse(file, enc);
+    Subtitle sub;
+    if (SubtitleCache::load(file, enc, &sub))
+        return sub;
+    sub = SubtitleParser::parse(file, enc);
+    SubtitleCache::save(file, enc, sub);
+    return sub;
 }
 
 auto Subtitle::isEmpty() const -> bool
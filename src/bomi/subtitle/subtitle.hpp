@@ -73,6 +73,8 @@ public:
     auto selection() const -> bool { return m_selection; }
     auto selection() -> bool& { return m_selection; }
     auto id() const -> int { return m_id; }
+    // gives new id to a copy of cached component
+    auto renewId() -> void { m_id = newId(); }
     auto type() const -> SubType { return m_type; }
     auto toTrack() const -> StreamTrack;
     auto encoding() const -> QString { return m_enc; }
@@ -80,7 +82,9 @@ public:
     static auto frame(int msec, double fps) -> int {return qRound(msec*1e-3*fps);}
 private:
     SubComp(SubType type, const QFileInfo &file, const QString &enc, int id, SyncType base);
+    static auto newId() -> int;
     friend class SubtitleParser;
+    friend class SubtitleCache;
     QString m_file, m_klass, m_path, m_enc;
     SyncType m_base = Time;
     Map m_capts;
@@ -109,6 +113,7 @@ public:
     static auto parse(const QString &fileName, const QString &enc) -> Subtitle;
 private:
     friend class SubtitleParser;
+    friend class SubtitleCache;
     QList<SubComp> m_comp;
 };
 
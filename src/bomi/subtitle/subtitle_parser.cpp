@@ -4,8 +4,7 @@ int SubtitleParser::msPerChar = -1;
 
 auto SubtitleParser::append(Subtitle &s, SubComp::SyncType b) -> SubComp&
 {
-    static int id = 0;
-    s.m_comp.append(SubComp(type(), m_file, m_encoding, id++, b));
+    s.m_comp.append(SubComp(type(), m_file, m_encoding, SubComp::newId(), b));
     return s.m_comp.last();
 }
 
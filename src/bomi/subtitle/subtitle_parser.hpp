@@ -9,6 +9,7 @@ public:
     static auto parse(const QString &file, const QString &enc) -> Subtitle;
     static auto setMsPerCharactor(int msPerChar) -> void
         { SubtitleParser::msPerChar = msPerChar; }
+    static auto msPerCharactor() -> int { return msPerChar; }
 protected:
     virtual bool isParsable() const = 0;
     virtual void _parse(Subtitle &sub) = 0;
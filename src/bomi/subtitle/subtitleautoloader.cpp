@@ -0,0 +1,274 @@
+#include "subtitleautoloader.hpp"
+#include "misc/charsetdetector.hpp"
+#include "misc/dataevent.hpp"
+#include "misc/runnable.hpp"
+#include "player/mrl.hpp"
+#include "player/streamtrack.hpp"
+#include <QThreadPool>
+
+struct Parsed {
+    QString encoding;
+    Subtitle subtitle;
+};
+
+struct SubtitleAutoloader::Job {
+    QString file; // local media file
+    Mrl mrl;
+    Autoloader autoloader;
+    QString fallback;
+    double autodetect = -1;
+    QStringList candidates;
+    StreamList restore; // candidates are files of these tracks if not empty
+    QVector<Parsed> parsed;
+    QAtomicInt remaining;
+    // below are guarded by Data::mutex
+    bool done = false;
+    Result result;
+    QObject *receiver = nullptr;
+    int event = 0;
+};
+
+struct SubtitleAutoloader::Data {
+    struct Cached {
+        qint64 size = -1;
+        QDateTime modified;
+        Parsed parsed;
+    };
+    QThreadPool pool;
+    QMutex mutex;
+    QSharedPointer<Job> job;
+    Autoloader autoloader;
+    QString fallback;
+    double autodetect = -1;
+    // key: file + fallback encoding + accuracy of autodetection
+    //      + encoding remembered for restored file
+    QHash<QString, Cached> cache;
+
+    auto newJob(const Mrl &mrl) -> QSharedPointer<Job>
+    {
+        QSharedPointer<Job> job(new Job);
+        job->file = mrl.toLocalFile();
+        job->mrl = mrl;
+        job->autoloader = autoloader;
+        job->fallback = fallback;
+        job->autodetect = autodetect;
+        return job;
+    }
+    auto isCurrent(const QSharedPointer<Job> &job) -> bool
+    {
+        QMutexLocker locker(&mutex);
+        return this->job == job;
+    }
+    auto find(Job &job) -> void
+    {
+        if (!job.restore.isEmpty()) {
+            for (auto &track : job.restore) {
+                if (!job.candidates.contains(track.file()))
+                    job.candidates.push_back(track.file());
+            }
+        } else if (job.autoloader.enabled && job.mrl.isLocalFile())
+            job.candidates = job.autoloader.autoload(job.mrl, SubtitleExt);
+    }
+    // restored file is parsed with encoding remembered for it
+    auto encoding(const Job &job, const QString &file) -> QString
+    {
+        for (auto &track : job.restore) {
+            if (track.file() == file)
+                return track.encoding();
+        }
+        return QString();
+    }
+    auto parse(const Job &job, const QString &file) -> Parsed
+    {
+        const QFileInfo info(file);
+        const auto restored = encoding(job, file);
+        const auto autodetect = job.restore.isEmpty() ? job.autodetect : -1;
+        const auto key = file % '|'_q % job.fallback % '|'_q
+                         % QString::number(autodetect) % '|'_q % restored;
+        mutex.lock();
+        auto it = cache.constFind(key);
+        if (it != cache.cend() && it->size == info.size()
+                && it->modified == info.lastModified()) {
+            const auto parsed = it->parsed;
+            mutex.unlock();
+            return parsed;
+        }
+        mutex.unlock();
+
+        Cached cached;
+        cached.size = info.size();
+        cached.modified = info.lastModified();
+        auto &enc = cached.parsed.encoding;
+        if (!restored.isEmpty())
+            enc = restored;
+        else if (autodetect >= 0)
+            enc = CharsetDetector::detect(file, autodetect);
+        if (enc.isEmpty())
+            enc = job.fallback;
+        cached.parsed.subtitle.load(file, enc, -1);
+
+        mutex.lock();
+        if (cache.size() > 64)
+            cache.clear();
+        cache.insert(key, cached);
+        mutex.unlock();
+        return cached.parsed;
+    }
+    auto assemble(const Job &job) -> Result
+    {
+        Result result;
+        if (!job.restore.isEmpty()) {
+            result.restored = true;
+            for (auto &track : job.restore) {
+                const auto &sub = job.parsed[job.candidates.indexOf(track.file())].subtitle;
+                for (int j = 0; j < sub.size(); ++j) {
+                    if (sub[j].language() == track.language()) {
+                        result.components.push_back(sub[j]);
+                        result.components.back().renewId();
+                        result.components.back().selection() = track.isSelected();
+                        break;
+                    }
+                }
+            }
+            return result;
+        }
+        for (int i = 0; i < job.candidates.size(); ++i) {
+            const auto &file = job.candidates[i];
+            const auto &parsed = job.parsed[i];
+            if (!parsed.subtitle.isEmpty()) {
+                for (int j = 0; j < parsed.subtitle.size(); ++j) {
+                    result.components.push_back(parsed.subtitle[j]);
+                    result.components.back().renewId();
+                }
+            } else {
+                result.files.push_back(file);
+                result.encodings[file] = parsed.encoding;
+            }
+        }
+        return result;
+    }
+    auto finish(const QSharedPointer<Job> &job) -> void
+    {
+        auto result = assemble(*job);
+        QMutexLocker locker(&mutex);
+        job->result = result;
+        job->done = true;
+        if (job->receiver && this->job == job)
+            _PostEvent(job->receiver, job->event, job->file, result);
+    }
+    auto run(const QSharedPointer<Job> &job) -> void
+    {
+        if (!isCurrent(job))
+            return;
+        find(*job);
+        const int size = job->candidates.size();
+        if (!size) {
+            finish(job);
+            return;
+        }
+        job->parsed.resize(size);
+        job->remaining = size;
+        for (int i = 0; i < size; ++i) {
+            pool.start(_Runnable([this, job, i] () {
+                if (isCurrent(job))
+                    job->parsed[i] = parse(*job, job->candidates[i]);
+                if (!job->remaining.deref())
+                    finish(job);
+            }));
+        }
+    }
+};
+
+SubtitleAutoloader::SubtitleAutoloader()
+    : d(new Data)
+{
+    d->pool.setMaxThreadCount(qMax(2, QThread::idealThreadCount()));
+}
+
+SubtitleAutoloader::~SubtitleAutoloader()
+{
+    d->mutex.lock();
+    d->job.reset();
+    d->mutex.unlock();
+    d->pool.waitForDone();
+    delete d;
+}
+
+auto SubtitleAutoloader::setAutoloader(const Autoloader &autoloader) -> void
+{
+    QMutexLocker locker(&d->mutex);
+    d->autoloader = autoloader;
+}
+
+auto SubtitleAutoloader::setEncoding(const QString &fallback, double autodetect) -> void
+{
+    QMutexLocker locker(&d->mutex);
+    d->fallback = fallback;
+    d->autodetect = autodetect;
+}
+
+auto SubtitleAutoloader::request(const Mrl &mrl) -> void
+{
+    d->mutex.lock();
+    auto job = d->job = d->newJob(mrl);
+    d->mutex.unlock();
+    d->pool.start(_Runnable([this, job] () { d->run(job); }));
+}
+
+auto SubtitleAutoloader::restore(const Mrl &mrl, const StreamList &tracks) -> void
+{
+    d->mutex.lock();
+    auto job = d->job = d->newJob(mrl);
+    job->restore = tracks;
+    d->mutex.unlock();
+    d->pool.start(_Runnable([this, job] () { d->run(job); }));
+}
+
+auto SubtitleAutoloader::take(const Mrl &mrl, Result *result) -> bool
+{
+    const auto file = mrl.toLocalFile();
+    d->mutex.lock();
+    if (d->job && d->job->file == file) {
+        const bool done = d->job->done;
+        if (done)
+            *result = d->job->result;
+        d->mutex.unlock();
+        return done;
+    }
+    d->mutex.unlock();
+    request(mrl);
+    return false;
+}
+
+auto SubtitleAutoloader::deliver(const Mrl &mrl, QObject *receiver, int type) -> void
+{
+    const auto file = mrl.toLocalFile();
+    d->mutex.lock();
+    if (!d->job || d->job->file != file) {
+        d->mutex.unlock();
+        request(mrl);
+        d->mutex.lock();
+    }
+    auto &job = d->job;
+    if (job->file == file) {
+        if (job->done)
+            _PostEvent(receiver, type, job->file, job->result);
+        else {
+            job->receiver = receiver;
+            job->event = type;
+        }
+    }
+    d->mutex.unlock();
+}
+
+auto SubtitleAutoloader::load(const Mrl &mrl) -> Result
+{
+    d->mutex.lock();
+    const auto job = d->newJob(mrl);
+    d->mutex.unlock();
+    d->find(*job);
+    job->parsed.resize(job->candidates.size());
+    for (int i = 0; i < job->candidates.size(); ++i)
+        job->parsed[i] = d->parse(*job, job->candidates[i]);
+    return d->assemble(*job);
+}
@@ -0,0 +1,41 @@
+#ifndef SUBTITLEAUTOLOADER_HPP
+#define SUBTITLEAUTOLOADER_HPP
+
+#include "subtitle.hpp"
+#include "misc/autoloader.hpp"
+
+class Mrl;                              class StreamList;
+
+// Finds, detects encoding of and parses subtitle files for a local media
+// in background so that mpv's on_load hook never waits for them.
+class SubtitleAutoloader {
+public:
+    struct Result {
+        // files which cannot be parsed by bomi and should be opened by mpv
+        QStringList files;
+        QMap<QString, QString> encodings;
+        QVector<SubComp> components;
+        // components are restored with their selection, see restore()
+        bool restored = false;
+    };
+    SubtitleAutoloader();
+    ~SubtitleAutoloader();
+    auto setAutoloader(const Autoloader &autoloader) -> void;
+    auto setEncoding(const QString &fallback, double autodetect) -> void;
+    // starts finding subtitles for mrl and cancels previous request
+    auto request(const Mrl &mrl) -> void;
+    // same as request() but parses inclusive tracks remembered in history
+    auto restore(const Mrl &mrl, const StreamList &tracks) -> void;
+    // never blocks; false if request for mrl has not finished yet
+    auto take(const Mrl &mrl, Result *result) -> bool;
+    // posts event of type with (QString file, Result) to receiver when done
+    auto deliver(const Mrl &mrl, QObject *receiver, int type) -> void;
+    // same as request() and take() in one go but blocks caller
+    auto load(const Mrl &mrl) -> Result;
+private:
+    struct Job;
+    struct Data;
+    Data *d;
+};
+
+#endif // SUBTITLEAUTOLOADER_HPP
@@ -0,0 +1,158 @@
+#include "subtitlecache.hpp"
+#include "subtitle_parser.hpp"
+#include "misc/log.hpp"
+
+DECLARE_LOG_CONTEXT(Subtitle)
+
+static constexpr quint32 Magic = 0x62737563; // bsuc
+static constexpr quint32 Version = 1;
+// entries neither read nor written for this period are removed once per run
+static constexpr int MaxAgeDays = 60;
+
+static auto operator << (QDataStream &out, const RichTextBlock &block) -> QDataStream&;
+static auto operator >> (QDataStream &in, RichTextBlock &block) -> QDataStream&;
+
+static auto operator << (QDataStream &out, const RichTextBlock::Format &format) -> QDataStream&
+    { return out << format.style << qint32(format.begin) << qint32(format.end); }
+
+static auto operator >> (QDataStream &in, RichTextBlock::Format &format) -> QDataStream&
+{
+    qint32 begin = 0, end = 0;
+    in >> format.style >> begin >> end;
+    format.begin = begin; format.end = end;
+    return in;
+}
+
+static auto operator << (QDataStream &out, const RichTextBlock::Ruby &ruby) -> QDataStream&
+    { return out << qint32(ruby.rb_begin) << qint32(ruby.rb_end) << ruby.rt_block; }
+
+static auto operator >> (QDataStream &in, RichTextBlock::Ruby &ruby) -> QDataStream&
+{
+    qint32 begin = -1, end = -1;
+    in >> begin >> end >> ruby.rt_block;
+    ruby.rb_begin = begin; ruby.rb_end = end;
+    return in;
+}
+
+static auto operator << (QDataStream &out, const RichTextBlock &block) -> QDataStream&
+    { return out << block.formats << block.text << block.paragraph << block.rubies; }
+
+static auto operator >> (QDataStream &in, RichTextBlock &block) -> QDataStream&
+    { return in >> block.formats >> block.text >> block.paragraph >> block.rubies; }
+
+auto SubtitleCache::key(const QFileInfo &info, const QString &enc) -> QString
+{
+    return info.absoluteFilePath() % '|'_q % QString::number(info.size())
+            % '|'_q % QString::number(info.lastModified().toMSecsSinceEpoch())
+            % '|'_q % enc.toLower()
+            % '|'_q % QString::number(SubtitleParser::msPerCharactor());
+}
+
+auto SubtitleCache::path(const QString &key) -> QString
+{
+    static const auto dir = []() {
+        const auto path = _WritablePath(Location::Cache) % "/subtitle"_a;
+        if (!QDir().mkpath(path))
+            return QString();
+        return path;
+    }();
+    if (dir.isEmpty())
+        return QString();
+    const auto hash = QCryptographicHash::hash(key.toUtf8(), QCryptographicHash::Md5);
+    return dir % '/'_q % _L(hash.toHex());
+}
+
+auto SubtitleCache::load(const QString &file, const QString &enc, Subtitle *sub) -> bool
+{
+    const QFileInfo info(file);
+    if (!info.exists())
+        return false;
+    const auto key = SubtitleCache::key(info, enc);
+    QFile cache(path(key));
+    if (cache.fileName().isEmpty() || !cache.open(QFile::ReadOnly))
+        return false;
+    const auto size = cache.size();
+    auto mapped = cache.map(0, size);
+    if (!mapped)
+        return false;
+    const auto raw = QByteArray::fromRawData((const char*)mapped, size);
+    QDataStream in(raw);
+    in.setVersion(QDataStream::Qt_5_2);
+
+    quint32 magic = 0, version = 0;
+    QString stored;
+    in >> magic >> version;
+    if (magic != Magic || version != Version)
+        return false;
+    in >> stored;
+    if (stored != key) // hash collision
+        return false;
+
+    Subtitle loaded;
+    qint32 comps = 0;
+    in >> comps;
+    for (int i = 0; i < comps && in.status() == QDataStream::Ok; ++i) {
+        SubComp comp;
+        qint32 type = 0, base = 0, capts = 0;
+        in >> type >> base >> comp.m_file >> comp.m_path >> comp.m_klass
+           >> comp.m_enc >> capts;
+        comp.m_type = static_cast<SubType>(type);
+        comp.m_base = static_cast<SubComp::SyncType>(base);
+        comp.m_id = SubComp::newId();
+        for (int j = 0; j < capts && in.status() == QDataStream::Ok; ++j) {
+            qint32 key = 0;
+            QList<RichTextBlock> blocks;
+            in >> key >> blocks;
+            auto &capt = comp.m_capts[key];
+            if (!blocks.isEmpty())
+                capt.doc() = blocks;
+        }
+        comp.m_capts[0].index = 0;
+        loaded.m_comp.push_back(comp);
+    }
+    cache.unmap(mapped);
+    if (in.status() != QDataStream::Ok) {
+        _Error("Broken cache for %%. Remove it.", file);
+        cache.remove();
+        return false;
+    }
+    *sub = loaded;
+    return true;
+}
+
+auto SubtitleCache::save(const QString &file, const QString &enc, const Subtitle &sub) -> void
+{
+    const QFileInfo info(file);
+    if (!info.exists())
+        return;
+    const auto key = SubtitleCache::key(info, enc);
+    const auto path = SubtitleCache::path(key);
+    if (path.isEmpty())
+        return;
+
+    static QAtomicInt pruned;
+    if (pruned.testAndSetOrdered(0, 1)) {
+        const auto limit = QDateTime::currentDateTime().addDays(-MaxAgeDays);
+        const auto entries = QFileInfo(path).dir().entryInfoList(QDir::Files);
+        for (auto &entry : entries) {
+            if (qMax(entry.lastModified(), entry.lastRead()) < limit)
+                QFile::remove(entry.absoluteFilePath());
+        }
+    }
+
+    QSaveFile cache(path);
+    if (!cache.open(QFile::WriteOnly | QFile::Truncate))
+        return;
+    QDataStream out(&cache);
+    out.setVersion(QDataStream::Qt_5_2);
+    out << Magic << Version << key << qint32(sub.m_comp.size());
+    for (auto &comp : sub.m_comp) {
+        out << qint32(comp.m_type) << qint32(comp.m_base) << comp.m_file
+            << comp.m_path << comp.m_klass << comp.m_enc
+            << qint32(comp.m_capts.size());
+        for (auto it = comp.m_capts.cbegin(); it != comp.m_capts.cend(); ++it)
+            out << qint32(it.key()) << it->blocks();
+    }
+    if (!cache.commit())
+        _Error("Cannot write subtitle cache for %%.", file);
+}
@@ -0,0 +1,19 @@
+#ifndef SUBTITLECACHE_HPP
+#define SUBTITLECACHE_HPP
+
+#include "subtitle.hpp"
+
+// On-disk cache of parsed subtitles. Entries are keyed by path, size,
+// modification time and encoding of subtitle file and by options affecting
+// parsing so that reopening a file never touches parser.
+class SubtitleCache {
+public:
+    // false if no valid entry exists; sub is empty for unparsable file
+    static auto load(const QString &file, const QString &enc, Subtitle *sub) -> bool;
+    static auto save(const QString &file, const QString &enc, const Subtitle &sub) -> void;
+private:
+    static auto key(const QFileInfo &info, const QString &enc) -> QString;
+    static auto path(const QString &key) -> QString;
+};
+
+#endif // SUBTITLECACHE_HPP
@@ -46,32 +46,28 @@ auto SubtitleDrawer::setStyle(const OsdStyle &style) -> void
 {
     m_style = style;
     updateStyle(m_front, style);
-    updateStyle(m_back, style);
+    m_layouts.clear();
     if (style.outline.enabled) {
         const auto size = style.font.height()*style.outline.width*2.0;
-        m_back.setTextOutline(style.outline.color, size);
+        m_outline = QPen(style.outline.color, size);
     } else
-        m_back.setTextOutline(Qt::NoPen);
+        m_outline = QPen(Qt::NoPen);
 }
 
 auto SubtitleDrawer::draw(QImage &image, int &gap, const RichTextDocument &text,
                           const QRectF &area, double dpr) -> QVector<QRectF>
 {
+    if (m_coverage)
+        return drawCoverage(image, gap, text, area, dpr);
     QVector<QRectF> bboxes;
     gap = 0;
     if (!(m_drawn = text.hasWords()))
         return bboxes;
     const double scale = this->scale(area)*dpr;
     const double fscale = m_style.font.height()*scale;
-    auto make = [=] (RichTextDocument &doc, const RichTextDocument &from) {
-        doc = from;
-        doc += text;
-        doc.updateLayoutInfo();
-        doc.doLayout(area.width()/(scale/dpr));
-    };
-    RichTextDocument front, back;
-    make(front, m_front);
-    make(back, m_back);
+    auto &front = m_layouts.get(m_front, text);
+    front.updateLayoutInfo();
+    front.doLayout(area.width()/(scale/dpr));
     QPoint thick(0, 0);
     if (m_style.bbox.enabled)
         thick = (fscale*m_style.bbox.padding).toPoint();
@@ -104,7 +100,8 @@ auto SubtitleDrawer::draw(QImage &image, int &gap, const RichTextDocument &text,
         QPainter painter(&image);
         painter.translate(origin/dpr);
         painter.scale(scale/dpr, scale/dpr);
-        back.draw(&painter, QPointF(0, 0));
+        if (m_outline.style() != Qt::NoPen)
+            front.drawOutline(&painter, QPointF(0, 0), m_outline);
         front.draw(&painter, QPointF(0, 0));
         painter.end();
         if (m_style.shadow.enabled) {
@@ -161,3 +158,94 @@ auto SubtitleDrawer::draw(QImage &image, int &gap, const RichTextDocument &text,
     }
     return bboxes;
 }
+
+auto SubtitleDrawer::effectPadding(double fscale) const -> int
+{
+    // independent of enabled flags so that toggling effects keeps the layout
+    const auto &offset = m_style.shadow.offset;
+    const double shadow = qMax(qAbs(offset.x()), qAbs(offset.y()));
+    return fscale*(m_style.outline.width + shadow) + blurRadius(fscale) + 2;
+}
+
+auto SubtitleDrawer::isSameLayout(const OsdStyle &lhs,
+                                  const OsdStyle &rhs) -> bool
+{
+    // color doesn't change layout
+    auto sameFont = [] (const OsdStyle::Font &lhs, const OsdStyle::Font &rhs)
+    {
+        return lhs.family() == rhs.family() && lhs.size == rhs.size
+                && lhs.font().pixelSize() == rhs.font().pixelSize()
+                && lhs.weight() == rhs.weight()
+                && lhs.italic() == rhs.italic()
+                && lhs.underline() == rhs.underline()
+                && lhs.strikeOut() == rhs.strikeOut();
+    };
+    return lhs.wrapMode == rhs.wrapMode && sameFont(lhs.font, rhs.font)
+            && lhs.spacing == rhs.spacing
+            && lhs.outline.width == rhs.outline.width
+            && lhs.shadow.offset == rhs.shadow.offset
+            && lhs.bbox.padding == rhs.bbox.padding;
+}
+
+auto SubtitleDrawer::drawCoverage(QImage &image, int &gap,
+                                  const RichTextDocument &text,
+                                  const QRectF &area,
+                                  double dpr) -> QVector<QRectF>
+{
+    QVector<QRectF> bboxes;
+    gap = 0;
+    if (!(m_drawn = text.hasWords()))
+        return bboxes;
+    const double scale = this->scale(area)*dpr;
+    const double fscale = m_style.font.height()*scale;
+    auto &front = m_layouts.get(m_front, text);
+    front.updateLayoutInfo();
+    front.doLayout(area.width()/(scale/dpr));
+    const QPoint thick = (fscale*m_style.bbox.padding).toPoint();
+    const int pad = effectPadding(fscale);
+    const QPoint offset = QPoint(pad, pad) + thick;
+    const auto nsize = front.naturalSize()*scale;
+    const QSize imageSize(nsize.width() + 1 + offset.x()*2,
+                          nsize.height() + 1 + offset.y()*2);
+    QImage argb(imageSize, QImage::Format_ARGB32_Premultiplied);
+    if (argb.isNull()) {
+        image = QImage();
+        return bboxes;
+    }
+    const auto x = -(area.width() * dpr - nsize.width()) * 0.5 + offset.x();
+    const QPointF origin(x, offset.y());
+    argb.setDevicePixelRatio(dpr);
+    argb.fill(0x0);
+    QPainter painter(&argb);
+    painter.translate(origin/dpr);
+    painter.scale(scale/dpr, scale/dpr);
+    front.draw(&painter, QPointF(0, 0));
+    painter.end();
+
+    static const auto gray = [] () {
+        QVector<QRgb> table(256);
+        for (int i = 0; i < table.size(); ++i)
+            table[i] = qRgba(i, i, i, i);
+        return table;
+    }();
+    // scanlines of Format_Indexed8 are 4-byte aligned like GL_UNPACK_ALIGNMENT
+    image = QImage(imageSize, QImage::Format_Indexed8);
+    image.setColorTable(gray);
+    image.setDevicePixelRatio(dpr);
+    for (int y = 0; y < image.height(); ++y) {
+        auto src = argb.constScanLine(y) + 3;
+        auto dest = image.scanLine(y);
+        for (int x = 0; x < image.width(); ++x, src += 4)
+            *dest++ = *src;
+    }
+    bboxes = front.boundingBoxes();
+    if (!bboxes.isEmpty()) {
+        for (auto &bbox : bboxes) {
+            bbox.setTopLeft(bbox.topLeft() * scale + origin - thick);
+            bbox.setBottomRight(bbox.bottomRight() * scale + origin + thick);
+        }
+        gap = image.height() - bboxes.last().bottom() + 1;
+        gap += thick.y()*2;
+    }
+    return bboxes;
+}
@@ -145,22 +145,33 @@ public:
     auto margin() const -> const Margin& { return m_margin; }
     auto style() const -> const OsdStyle& {return m_style;}
     auto scale(const QRectF &area) const -> double;
+    // draw only glyph coverage into an 8-bit image and leave outline, shadow
+    // and box to SubtitleShader
+    auto setCoverageOnly(bool on) -> void { m_coverage = on; }
+    auto isCoverageOnly() const -> bool { return m_coverage; }
+    auto effectPadding(double fscale) const -> int;
+    auto blurRadius(double fscale) const -> int { return qRound(fscale*0.01); }
+    static auto isSameLayout(const OsdStyle &lhs, const OsdStyle &rhs) -> bool;
 private:
+    auto drawCoverage(QImage &image, int &gap, const RichTextDocument &text,
+                      const QRectF &area, double dpr) -> QVector<QRectF>;
     static auto updateStyle(RichTextDocument &doc,
                             const OsdStyle &style) -> void;
     OsdStyle m_style;
-    RichTextDocument m_front, m_back;
+    RichTextDocument m_front;
+    RichTextLayoutCache m_layouts;
+    QPen m_outline = {Qt::NoPen};
     Margin m_margin;
     Qt::Alignment m_alignment;
-    bool m_drawn = false;
+    bool m_drawn = false, m_coverage = false;
     FastAlphaBlur m_blur;
     QByteArray m_buffer;
 };
 
 inline auto SubtitleDrawer::setAlignment(Qt::Alignment alignment) -> void
 {
-    m_back.setAlignment(m_alignment = alignment);
-    m_front.setAlignment(alignment);
+    m_front.setAlignment(m_alignment = alignment);
+    m_layouts.clear();
 }
 
 inline auto SubtitleDrawer::draw(SubCompImage &pic, const QRectF &area,
@@ -1,9 +1,10 @@
 #include "subtitlemodel.hpp"
 
 struct SubCompModel::Data {
-    bool visible;
-    const SubComp *comp;
-    const SubCapt *pended;
+    bool visible = false, pending = false;
+    const SubComp *comp = nullptr;
+    SubComp::ConstIt pended, next;
+    double mul = 1.0;
 };
 
 SubCompModel::SubCompModel(const SubComp *comp, QObject *parent)
@@ -11,31 +12,46 @@ SubCompModel::SubCompModel(const SubComp *comp, QObject *parent)
     , d(new Data)
 {
     d->comp = comp;
-    d->visible = false;
-    d->pended = 0;
+    d->next = comp->begin();
     QFont font; font.setBold(true); font.setItalic(true);
     setSpecialFont(font);
+}
+
+SubCompModel::~SubCompModel()
+{
+    delete d;
+}
+
+auto SubCompModel::canFetchMore(const QModelIndex &parent) const -> bool
+{
+    return !parent.isValid() && d->next != d->comp->end();
+}
 
-    auto it = comp->begin();
+auto SubCompModel::fetchMore(const QModelIndex &parent) -> void
+{
+    if (!parent.isValid())
+        fetch(PageSize);
+}
+
+auto SubCompModel::fetch(int rows) -> void
+{
+    // a page ends just before a caption with words so that end time of
+    // every row already in model is known and never changes afterward
     QList<SubCompModelData> list;
-    for (; it != comp->end(); ++it) {
+    const auto end = d->comp->end();
+    auto &it = d->next;
+    for (; it != end; ++it) {
+        if (!list.isEmpty() && list.last().m_end < 0)
+            list.last().m_end = it.key();
         if (it->hasWords()) {
-            it->index = 0;
+            if (list.size() >= rows)
+                break;
             list.append(it);
-            break;
+            list.last().m_mul = d->mul;
         }
+        it->index = size() + list.size() - 1;
     }
-    if (!list.isEmpty()) {
-        for (++it; it != comp->end(); ++it) {
-            auto &last = list.last();
-            if (last.m_end < 0)
-                last.m_end = it.key();
-            if (it->hasWords())
-                list.append(it);
-            it->index = list.size() - 1;
-        }
-    }
-    setList(list);
+    append(list);
 }
 
 auto SubCompModel::header(int column) const -> QString
@@ -66,12 +82,12 @@ auto SubCompModel::name() const -> QString
 
 auto SubCompModel::setFps(double fps) -> void
 {
-    if (d->comp->isBasedOnFrame()) {
-        beginResetModel();
-        const auto mul = 1000.0/fps;
+    if (d->comp->isBasedOnFrame() && _Change(d->mul, 1000.0/fps)) {
         for (auto &data : getList())
-            data.m_mul = mul;
-        endResetModel();
+            data.m_mul = d->mul;
+        if (!isEmpty())
+            emit QAbstractItemModel::dataChanged(index(0, Start),
+                                                 index(size() - 1, End));
     }
 }
 
@@ -79,18 +95,25 @@ auto SubCompModel::setVisible(bool visible) -> void
 {
     if (d->visible != visible) {
         d->visible = visible;
-        if (d->visible && d->pended)
+        if (d->visible && d->pending)
             setCurrentCaption(d->pended);
     }
 }
 
-auto SubCompModel::setCurrentCaption(const SubCapt *caption) -> void
+auto SubCompModel::setCurrentCaption(SubComp::ConstIt it) -> void
 {
     if (!d->visible) {
-        d->pended = caption;
+        d->pended = it;
+        d->pending = true;
     } else {
-        d->pended = 0;
-        setSpecialRow(caption ? caption->index : -1);
+        d->pending = false;
+        if (it == d->comp->end()) {
+            setSpecialRow(-1);
+            return;
+        }
+        while (d->next != d->comp->end() && d->next.key() <= it.key())
+            fetch(PageSize);
+        setSpecialRow(it->index);
     }
 }
 
@@ -21,12 +21,18 @@ class SubCompModel : public SimpleListModel<SubCompModelData> {
     Q_OBJECT
 public:
     enum Column {Start = 0, End, Text, ColumnCount};
+    // rows are built from captions page by page on demand of view
+    static constexpr int PageSize = 256;
     SubCompModel(const SubComp *comp, QObject *parent = 0);
+    ~SubCompModel();
     auto name() const -> QString;
     auto setFps(double fps) -> void;
-    auto setCurrentCaption(const SubCapt *caption) -> void;
+    auto setCurrentCaption(SubComp::ConstIt it) -> void;
     auto setVisible(bool visible) -> void;
+    auto canFetchMore(const QModelIndex &parent) const -> bool final;
+    auto fetchMore(const QModelIndex &parent) -> void final;
 private:
+    auto fetch(int rows) -> void;
     auto header(int column) const -> QString final;
     auto displayData(int row, int column) const -> QVariant final;
     struct Data;
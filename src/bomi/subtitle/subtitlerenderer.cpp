@@ -9,6 +9,10 @@
 struct SubtitleShaderData : public SubtitleRenderer::ShaderData {
     const OpenGLTexture2D *texture, *bbox;
     QColor bboxColor;
+    bool coverage = false;
+    QColor fillColor, outlineColor, shadowColor;
+    QPointF texel, shadowOffset;
+    float outlineWidth = 0.f, shadowBlur = 0.f;
 };
 
 struct SubtitleShader : public SubtitleRenderer::ShaderIface {
@@ -24,13 +28,54 @@ struct SubtitleShader : public SubtitleRenderer::ShaderIface {
                 gl_Position = qt_Matrix * aPosition;
             }
         )";
+        // when coverage is set, tex holds only glyph coverage in red channel
+        // and outline, shadow and blur are done here in texel units
         fragmentShader = (R"(
             uniform sampler2D tex;
             uniform sampler2D bbox;
             uniform vec4 bboxColor;
+            uniform bool coverage;
+            uniform vec4 fillColor, outlineColor, shadowColor;
+            uniform vec2 texel, shadowOffset;
+            uniform float outlineWidth, shadowBlur;
             varying vec2 texCoord;
+            vec4 premultiplied(vec4 c) { return vec4(c.rgb*c.a, c.a); }
+            float fill(vec2 tc) { return texture2D(tex, tc).r; }
+            float outline(vec2 tc) {
+                float a = fill(tc);
+                if (outlineWidth > 0.0) {
+                    for (int i = 0; i < 8; ++i) {
+                        float t = float(i)*0.78539816;
+                        vec2 d = vec2(cos(t), sin(t))*outlineWidth*texel;
+                        a = max(a, max(fill(tc + d), fill(tc + d*0.5)));
+                    }
+                }
+                return a;
+            }
+            float shape(vec2 tc) {
+                return outlineColor.a > 0.0 ? outline(tc) : fill(tc);
+            }
+            float shadow(vec2 tc) {
+                tc -= shadowOffset*texel;
+                if (shadowBlur <= 0.0)
+                    return shape(tc);
+                vec2 d = shadowBlur*texel;
+                return (shape(tc)*2.0 + shape(tc + d) + shape(tc - d)
+                        + shape(tc + vec2(d.x, -d.y))
+                        + shape(tc + vec2(-d.x, d.y)))/6.0;
+            }
             void main() {
-                vec4 top = texture2D(tex, texCoord);
+                vec4 top;
+                if (coverage) {
+                    top = premultiplied(fillColor)*fill(texCoord);
+                    if (outlineColor.a > 0.0)
+                        top += premultiplied(outlineColor)
+                                *outline(texCoord)*(1.0 - top.a);
+                    if (shadowColor.a > 0.0)
+                        top += premultiplied(shadowColor)
+                                *shadow(texCoord)*(1.0 - top.a);
+                } else
+                    top = texture2D(tex, texCoord);
                 float alpha = texture2D(bbox, texCoord).a*bboxColor.a*(1.0 - top.a);
                 gl_FragColor = top + bboxColor*alpha;
             }
@@ -41,6 +86,14 @@ struct SubtitleShader : public SubtitleRenderer::ShaderIface {
         loc_tex = prog->uniformLocation("tex");
         loc_bbox = prog->uniformLocation("bbox");
         loc_bboxColor = prog->uniformLocation("bboxColor");
+        loc_coverage = prog->uniformLocation("coverage");
+        loc_fillColor = prog->uniformLocation("fillColor");
+        loc_outlineColor = prog->uniformLocation("outlineColor");
+        loc_shadowColor = prog->uniformLocation("shadowColor");
+        loc_texel = prog->uniformLocation("texel");
+        loc_shadowOffset = prog->uniformLocation("shadowOffset");
+        loc_outlineWidth = prog->uniformLocation("outlineWidth");
+        loc_shadowBlur = prog->uniformLocation("shadowBlur");
     }
     void update(QOpenGLShaderProgram *prog
                 , const SubtitleRenderer::ShaderData *data) override {
@@ -49,10 +102,23 @@ struct SubtitleShader : public SubtitleRenderer::ShaderIface {
         d->texture->bind(prog, loc_tex, 0);
         d->bbox->bind(prog, loc_bbox, 1);
         prog->setUniformValue(loc_bboxColor, d->bboxColor);
+        prog->setUniformValue(loc_coverage, d->coverage);
+        if (d->coverage) {
+            prog->setUniformValue(loc_fillColor, d->fillColor);
+            prog->setUniformValue(loc_outlineColor, d->outlineColor);
+            prog->setUniformValue(loc_shadowColor, d->shadowColor);
+            prog->setUniformValue(loc_texel, d->texel);
+            prog->setUniformValue(loc_shadowOffset, d->shadowOffset);
+            prog->setUniformValue(loc_outlineWidth, d->outlineWidth);
+            prog->setUniformValue(loc_shadowBlur, d->shadowBlur);
+        }
         f->glActiveTexture(GL_TEXTURE0);
     }
 private:
-    int loc_tex = -1, loc_bbox = -1, loc_bboxColor = -1;
+    int loc_tex = -1, loc_bbox = -1, loc_bboxColor = -1, loc_coverage = -1;
+    int loc_fillColor = -1, loc_outlineColor = -1, loc_shadowColor = -1;
+    int loc_texel = -1, loc_shadowOffset = -1;
+    int loc_outlineWidth = -1, loc_shadowBlur = -1;
 };
 
 struct SubtitleRenderer::Data {
@@ -61,9 +127,11 @@ struct SubtitleRenderer::Data {
     QList<SubComp*> loaded;
     QSize imageSize{0, 0};
     SubtitleDrawer drawer;
+    SubtitleDrawer still; // copy of drawer with all effects for draw()
+    bool stillChanged = true;
     int delay = 0, msec = 0;
     bool selecting = false, textChanged = true;
-    bool top = false, hidden = false, empty = true;
+    bool top = false, hidden = false, empty = true, gpu = false;
     double pos = 1.0;
     QMap<QString, int> langMap;
     QMutex mutex;
@@ -88,6 +156,7 @@ struct SubtitleRenderer::Data {
 
     double fps() const { return selection.fps(); }
     void updateDrawer() {
+        stillChanged = true;
         selection.setDrawer(drawer);
         p->reserve(UpdateGeometry);
     }
@@ -98,6 +167,7 @@ struct SubtitleRenderer::Data {
     }
     void setMargin(const Margin &margin) {
         drawer.setMargin(margin);
+        stillChanged = true;
         p->reserve(UpdateGeometry);
     }
     void applySelection() {
@@ -186,33 +256,57 @@ auto SubtitleRenderer::setPriority(const QStringList &priority) -> void
 
 auto SubtitleRenderer::setStyle(const OsdStyle &style) -> void
 {
+    const bool relayout = !d->gpu
+            || !SubtitleDrawer::isSameLayout(d->drawer.style(), style);
     d->drawer.setStyle(style);
-    d->updateDrawer();
+    d->stillChanged = true;
+    if (relayout)
+        d->updateDrawer();
+    else // only uniforms changed
+        reserve(UpdateMaterial);
+}
+
+auto SubtitleRenderer::setEffectsOnGpu(bool gpu) -> void
+{
+    if (_Change(d->gpu, gpu)) {
+        d->drawer.setCoverageOnly(gpu);
+        d->updateDrawer();
+    }
+}
+
+auto SubtitleRenderer::isEffectsOnGpu() const -> bool
+{
+    return d->gpu;
 }
 
 auto SubtitleRenderer::draw(const QRectF &rect, QRectF *put) const -> QImage
 {
     QImage sub; int gap = 0;
-    auto boxes = d->drawer.draw(sub, gap, text(), rect, 1.0);
+    if (_Change(d->stillChanged, false)) {
+        d->still = d->drawer;
+        d->still.setCoverageOnly(false);
+    }
+    auto &drawer = d->still;
+    auto boxes = drawer.draw(sub, gap, text(), rect, 1.0);
     if (sub.isNull())
         return QImage();
     if (put)
-        *put = {d->drawer.pos(sub.size(), rect), sub.size()};
+        *put = {drawer.pos(sub.size(), rect), sub.size()};
     if (!boxes.isEmpty()) {
         QImage bg(sub.size(), QImage::Format_ARGB32_Premultiplied);
         bg.fill(0x0);
         QPainter painter(&bg);
-        auto bcolor = d->drawer.style().bbox.color;
+        auto bcolor = drawer.style().bbox.color;
         bcolor.setAlpha(255);
         for (auto &bbox : boxes)
             painter.fillRect(bbox, bcolor);
         auto p = bg.bits();
         for (int i=0; i<bg.width(); ++i) {
             for (int j=0; j<bg.height(); ++j) {
-                *p++ *= d->drawer.style().bbox.color.alphaF();
-                *p++ *= d->drawer.style().bbox.color.alphaF();
-                *p++ *= d->drawer.style().bbox.color.alphaF();
-                *p++ *= d->drawer.style().bbox.color.alphaF();
+                *p++ *= drawer.style().bbox.color.alphaF();
+                *p++ *= drawer.style().bbox.color.alphaF();
+                *p++ *= drawer.style().bbox.color.alphaF();
+                *p++ *= drawer.style().bbox.color.alphaF();
             }
         }
         painter.drawImage(QPoint(0, 0), sub);
@@ -289,7 +383,23 @@ auto SubtitleRenderer::updateData(ShaderData *sd) -> void
 {
     auto data = static_cast<SubtitleShaderData*>(sd);
     updateTexture(&texture());
-    data->bboxColor = d->drawer.style().bbox.color;
+    const auto &style = d->drawer.style();
+    auto color = [] (bool enabled, const QColor &c)
+        { return enabled ? c : QColor(Qt::transparent); };
+    // boxes are always drawn in coverage mode
+    data->bboxColor = color(!d->gpu || style.bbox.enabled, style.bbox.color);
+    data->coverage = d->gpu;
+    if (!d->gpu || texture().isEmpty())
+        return;
+    const double fscale = style.font.height()
+            * d->drawer.scale(rect()) * devicePixelRatio();
+    data->texel = {1.0/texture().width(), 1.0/texture().height()};
+    data->fillColor = style.font.color;
+    data->outlineColor = color(style.outline.enabled, style.outline.color);
+    data->outlineWidth = fscale*style.outline.width;
+    data->shadowColor = color(style.shadow.enabled, style.shadow.color);
+    data->shadowOffset = fscale*style.shadow.offset;
+    data->shadowBlur = style.shadow.blur ? d->drawer.blurRadius(fscale) : 0;
 }
 
 auto SubtitleRenderer::updateTexture(OpenGLTexture2D *texture) -> void
@@ -309,13 +419,15 @@ auto SubtitleRenderer::updateTexture(OpenGLTexture2D *texture) -> void
         _Expand(d->zeros, len);
         OpenGLTextureBinder<OGL::Target2D> binder;
         binder.bind(texture);
-        texture->initialize(d->imageSize, d->zeros.data());
+        const auto format = d->gpu ? OGL::OneComponent : OGL::BGRA;
+        texture->initialize(d->imageSize, OpenGLTextureTransferInfo::get(format),
+                            d->zeros.data());
         binder.bind(&d->bbox);
         d->bbox.initialize(d->imageSize, d->zeros.data());
         int y = 0;
         d->selection.forImages([&] (const SubCompImage &image) {
             const int x = (texture->width() - image.width())*0.5;
-            if (!image.isNull()) {
+            if (!image.isNull() && (image.format() == QImage::Format_Indexed8) == d->gpu) {
                 binder.bind(texture);
                 texture->upload(x, y, image.width(), image.height(), image.bits());
                 binder.bind(&d->bbox);
@@ -38,6 +38,8 @@ public:
     auto deselect(int id = -1) -> void;
     auto style() const -> const OsdStyle&;
     auto setStyle(const OsdStyle &style) -> void;
+    auto setEffectsOnGpu(bool gpu) -> void;
+    auto isEffectsOnGpu() const -> bool;
     auto text() const -> const RichTextDocument&;
     auto draw(const QRectF &rect, QRectF *put = nullptr) const -> QImage;
     auto updateVertexOnGeometryChanged() const -> bool override { return true; }
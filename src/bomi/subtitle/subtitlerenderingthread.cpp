@@ -269,7 +269,7 @@ auto SubCompSelection::update(const SubCompImage &image) -> bool
     if (!item)
         return false;
     item->image = image;
-    item->model->setCurrentCaption(&(*image.iterator()));
+    item->model->setCurrentCaption(image.iterator());
     return true;
 }
 
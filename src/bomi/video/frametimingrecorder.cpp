@@ -0,0 +1,276 @@
+#include "frametimingrecorder.hpp"
+#include "misc/log.hpp"
+#include <QOpenGLTimerQuery>
+#include <cmath>
+
+DECLARE_LOG_CONTEXT(Video)
+
+struct TimerSlot {
+    QOpenGLTimerQuery *query = nullptr;
+    quint64 frame = 0;
+    bool pending = false;
+};
+
+struct FrameTimingRecorder::Data {
+    QElapsedTimer timer;
+    mutable QMutex mutex;   // below are guarded by this
+    QVector<FrameTiming> ring;
+    quint64 frame = 0;      // last frame recorded
+    std::deque<qint64> decoded, queued;
+    double hz = 0.0;
+
+    // only for render thread
+    FrameTiming current;
+    std::array<TimerSlot, 4> timers;
+    TimerSlot *active = nullptr;
+
+    auto now() const -> qint64 { return timer.nsecsElapsed() / 1000; }
+    auto find(quint64 frame) -> FrameTiming*
+    {
+        if (!frame)
+            return nullptr;
+        auto &record = ring[(frame - 1) % ring.size()];
+        return record.frame == frame ? &record : nullptr;
+    }
+    // drops stamps which cannot belong to a frame to be rendered
+    static auto take(std::deque<qint64> &stamps, int ahead) -> qint64
+    {
+        while ((int)stamps.size() > ahead)
+            stamps.pop_front();
+        if (stamps.empty())
+            return 0;
+        const auto ts = stamps.front();
+        stamps.pop_front();
+        return ts;
+    }
+    auto poll() -> void
+    {
+        for (auto &slot : timers) {
+            if (!slot.pending || !slot.query->isResultAvailable())
+                continue;
+            const auto ns = slot.query->waitForResult();
+            slot.pending = false;
+            QMutexLocker locker(&mutex);
+            if (auto record = find(slot.frame))
+                record->gpu = ns / 1000;
+        }
+    }
+};
+
+FrameTimingRecorder::FrameTimingRecorder(int capacity)
+    : d(new Data)
+{
+    Q_ASSERT(capacity > 1);
+    d->ring.resize(capacity);
+    d->timer.start();
+}
+
+FrameTimingRecorder::~FrameTimingRecorder()
+{
+    Q_ASSERT(!d->timers[0].query); // finalizeGL() should be called
+    delete d;
+}
+
+auto FrameTimingRecorder::capacity() const -> int
+{
+    return d->ring.size();
+}
+
+auto FrameTimingRecorder::stamp(Stage stage) -> void
+{
+    const auto ts = d->now();
+    QMutexLocker locker(&d->mutex);
+    auto &stamps = stage == Decoded ? d->decoded : d->queued;
+    stamps.push_back(ts);
+    if (stamps.size() > 16)
+        stamps.pop_front();
+}
+
+auto FrameTimingRecorder::initializeGL() -> void
+{
+    for (auto &slot : d->timers) {
+        slot = TimerSlot();
+        slot.query = new QOpenGLTimerQuery;
+        if (!slot.query->create()) {
+            _Debug("Timer query is not supported. GPU time won't be measured.");
+            finalizeGL();
+            return;
+        }
+    }
+}
+
+auto FrameTimingRecorder::finalizeGL() -> void
+{
+    d->active = nullptr;
+    for (auto &slot : d->timers) {
+        if (slot.query)
+            slot.query->destroy();
+        _Delete(slot.query);
+        slot.pending = false;
+    }
+}
+
+auto FrameTimingRecorder::beginRender() -> void
+{
+    if (d->timers[0].query) {
+        d->poll();
+        auto it = std::find_if(d->timers.begin(), d->timers.end(),
+                               [] (const TimerSlot &s) { return !s.pending; });
+        if (it != d->timers.end()) {
+            d->active = &*it;
+            d->active->query->begin();
+        }
+    }
+    d->current = FrameTiming();
+    d->current.rendered = d->now();
+    QMutexLocker locker(&d->mutex);
+    // vo keeps only a few frames queued
+    d->current.queued = d->take(d->queued, 2);
+    d->current.decoded = d->take(d->decoded, 4);
+}
+
+auto FrameTimingRecorder::endRender(int delayed) -> void
+{
+    d->current.finished = d->now();
+    d->current.delayed = delayed;
+    QMutexLocker locker(&d->mutex);
+    d->current.frame = ++d->frame;
+    d->ring[(d->frame - 1) % d->ring.size()] = d->current;
+    if (d->active) {
+        d->active->query->end();
+        d->active->frame = d->frame;
+        d->active->pending = true;
+        d->active = nullptr;
+    }
+}
+
+auto FrameTimingRecorder::swapped() -> void
+{
+    const auto ts = d->now();
+    QMutexLocker locker(&d->mutex);
+    auto record = d->find(d->frame);
+    if (record && !record->swapped)
+        record->swapped = ts;
+}
+
+auto FrameTimingRecorder::setRefreshRate(double hz) -> void
+{
+    QMutexLocker locker(&d->mutex);
+    d->hz = hz;
+}
+
+auto FrameTimingRecorder::refreshRate() const -> double
+{
+    QMutexLocker locker(&d->mutex);
+    return d->hz;
+}
+
+auto FrameTimingRecorder::clear() -> void
+{
+    QMutexLocker locker(&d->mutex);
+    d->decoded.clear();
+    d->queued.clear();
+    for (auto &record : d->ring)
+        record = FrameTiming();
+}
+
+auto FrameTimingRecorder::records() const -> QVector<FrameTiming>
+{
+    QVector<FrameTiming> records;
+    QMutexLocker locker(&d->mutex);
+    records.reserve(d->ring.size());
+    const quint64 size = d->ring.size();
+    const quint64 from = d->frame > size ? d->frame - size + 1 : 1;
+    for (auto frame = from; frame <= d->frame; ++frame) {
+        auto &record = d->ring[(frame - 1) % size];
+        if (record.frame == frame)
+            records.push_back(record);
+    }
+    return records;
+}
+
+auto FrameTimingRecorder::stats(int bins) const -> FrameTimingStats
+{
+    Q_ASSERT(bins > 0);
+    const auto records = this->records();
+    const auto hz = refreshRate();
+    FrameTimingStats stats;
+    stats.histogram.fill(0, bins);
+    stats.frames = records.size();
+
+    QVector<double> intervals;
+    intervals.reserve(records.size());
+    double render = 0, gpu = 0, latency = 0;
+    int gpus = 0, latencies = 0;
+    for (int i = 0; i < records.size(); ++i) {
+        auto &r = records[i];
+        render += (r.finished - r.rendered) * 1e-3;
+        if (r.gpu >= 0) {
+            gpu += r.gpu * 1e-3;
+            ++gpus;
+        }
+        if (r.queued > 0 && r.swapped > 0) {
+            latency += (r.swapped - r.queued) * 1e-3;
+            ++latencies;
+        }
+        if (i > 0 && r.swapped > 0 && records[i - 1].swapped > 0
+                && r.frame == records[i - 1].frame + 1)
+            intervals.push_back((r.swapped - records[i - 1].swapped) * 1e-3);
+    }
+    if (!records.isEmpty())
+        stats.render = render / records.size();
+    if (gpus > 0)
+        stats.gpu = gpu / gpus;
+    if (latencies > 0)
+        stats.latency = latency / latencies;
+    if (intervals.isEmpty())
+        return stats;
+
+    double sum = 0, sq = 0;
+    for (auto interval : intervals) {
+        sum += interval;
+        sq += interval * interval;
+        ++stats.histogram[qBound(0, (int)interval, bins - 1)];
+    }
+    stats.interval = sum / intervals.size();
+    stats.jitter = std::sqrt(qMax(0.0, sq / intervals.size()
+                                  - stats.interval * stats.interval));
+    // late if presented one or more vsyncs after expected
+    auto expected = stats.interval;
+    if (hz > 1) {
+        const auto vsync = 1000.0 / hz;
+        expected = qMax(1.0, std::round(expected / vsync)) * vsync;
+    }
+    for (auto interval : intervals) {
+        if (interval > expected * 1.5)
+            ++stats.late;
+    }
+    return stats;
+}
+
+auto FrameTimingRecorder::save(const QString &fileName) const -> bool
+{
+    const auto records = this->records();
+    QByteArray csv;
+    csv += "# refresh rate: " + QByteArray::number(refreshRate(), 'f', 3) + " Hz\n";
+    csv += "# timestamps are in usecs, 0 or -1 if not available\n";
+    csv += "frame,decoded,queued,render_begin,render_end,swapped,gpu,delayed\n";
+    for (auto &r : records) {
+        csv += QByteArray::number(r.frame) + ',';
+        csv += QByteArray::number(r.decoded) + ',';
+        csv += QByteArray::number(r.queued) + ',';
+        csv += QByteArray::number(r.rendered) + ',';
+        csv += QByteArray::number(r.finished) + ',';
+        csv += QByteArray::number(r.swapped) + ',';
+        csv += QByteArray::number(r.gpu) + ',';
+        csv += QByteArray::number(r.delayed) + '\n';
+    }
+    QSaveFile file(fileName);
+    if (!file.open(QFile::WriteOnly | QFile::Truncate)
+            || file.write(csv) < 0 || !file.commit()) {
+        _Error("Cannot write frame timings to %%.", fileName);
+        return false;
+    }
+    _Info("%% frame timing(s) written to %%.", records.size(), fileName);
+    return true;
+}
@@ -0,0 +1,49 @@
+#ifndef FRAMETIMINGRECORDER_HPP
+#define FRAMETIMINGRECORDER_HPP
+
+// timestamps are in usecs since the recorder was created; 0 if not known
+struct FrameTiming {
+    quint64 frame = 0;
+    qint64 decoded = 0, queued = 0, rendered = 0, finished = 0, swapped = 0;
+    qint64 gpu = -1; // elapsed on gpu in usecs; -1 if not available
+    int delayed = 0;
+};
+
+struct FrameTimingStats {
+    QVector<int> histogram; // swap intervals with 1ms bins
+    int frames = 0, late = 0;
+    // in msecs; negative if not available
+    double interval = -1, jitter = -1, render = -1, gpu = -1, latency = -1;
+};
+
+// Records per-frame timestamps from decoding to swap in a ring buffer.
+// Stages of a frame are matched in order, so stamps of frames dropped
+// between decoder and renderer can be attributed to next frame.
+class FrameTimingRecorder {
+public:
+    enum Stage { Decoded, Queued };
+    FrameTimingRecorder(int capacity = 512);
+    ~FrameTimingRecorder();
+    auto capacity() const -> int;
+    // can be called in any thread
+    auto stamp(Stage stage) -> void;
+    // below are called in render thread with current context
+    auto initializeGL() -> void;
+    auto finalizeGL() -> void;
+    auto beginRender() -> void;
+    auto endRender(int delayed) -> void;
+    auto swapped() -> void;
+
+    auto setRefreshRate(double hz) -> void;
+    auto refreshRate() const -> double;
+    auto clear() -> void;
+    auto records() const -> QVector<FrameTiming>;
+    auto stats(int bins) const -> FrameTimingStats;
+    // writes records as csv
+    auto save(const QString &fileName) const -> bool;
+private:
+    struct Data;
+    Data *d;
+};
+
+#endif // FRAMETIMINGRECORDER_HPP
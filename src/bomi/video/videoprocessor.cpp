@@ -371,6 +371,7 @@ auto VideoProcessor::filterOut() -> int
     if (_Change(d->inter_o, d->deinterlacer.pass() ? d->inter_i : false))
         emit outputInterlacedChanged();
     vf_add_output_frame(d->vf, mpi.take());
+    emit frameFiltered();
     return 0;
 }
 
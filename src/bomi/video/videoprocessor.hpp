@@ -26,6 +26,8 @@ signals:
     void skippingChanged(bool skipping);
     void seekRequested(int msec);
     void fpsManimulated(double fps);
+    // emitted in decoder thread whenever a frame is passed to vo
+    void frameFiltered();
 private:
     static auto open(vf_instance *vf) -> int;
     static auto queryFormat(vf_instance *vf, uint fmt) -> int;
@@ -7,6 +7,7 @@
 #include "misc/log.hpp"
 #include <QQmlProperty>
 #include <QQuickWindow>
+#include <QPointer>
 
 DECLARE_LOG_CONTEXT(Video)
 
@@ -27,6 +28,16 @@ struct VideoRenderer::Data {
     QSize displaySize{0, 1}, fboSize, prevSize;
     QTimer sizeChecker;
     RenderFrameFunc render = nullptr;
+    RenderDirectFunc renderDirect = nullptr;
+    bool directRequested = false, direct = false; // guarded by sync
+    QPointer<QQuickWindow> window;
+    QMetaObject::Connection beforeRendering;
+    // below are for render thread; copied in updateTexture() during sync
+    struct {
+        bool active = false, flip = false, frame = false, redraw = false;
+        QRect viewport;
+        QColor color;
+    } target;
 
     static auto isSameRatio(double r1, double r2) -> bool
         {return (r1 < 0.0 && r2 < 0.0) || qFuzzyCompare(r1, r2);}
@@ -93,6 +104,71 @@ struct VideoRenderer::Data {
         size.scale(vtx.width() + 0.5, vtx.height() + 0.5, Qt::KeepAspectRatio);
         return size;
     }
+    // horizontal flip, aspect override and transformed or translucent item
+    // are done by drawing texture
+    auto canRenderDirect() const -> bool
+    {
+        if (!directRequested || !renderDirect || !p->window())
+            return false;
+        if (flip_h || aspect >= 0.0 || !qFuzzyCompare(p->opacity(), 1.0))
+            return false;
+        for (auto item = p->parentItem(); item; item = item->parentItem()) {
+            if (!qFuzzyCompare(item->opacity(), 1.0))
+                return false;
+        }
+        const auto t = p->itemTransform(nullptr, nullptr);
+        return !t.isRotating() && t.m11() > 0 && t.m22() > 0;
+    }
+    auto updateDirect() -> void
+    {
+        if (_Change(direct, canRenderDirect())) {
+            _Debug("Render video %%.", direct ? "directly" : "via framebuffer object");
+            p->window()->setClearBeforeRendering(!direct);
+            redraw = true;
+            p->reserve(UpdateAll);
+        }
+    }
+    auto renderTarget() -> void
+    {
+        auto w = p->window();
+        if (!target.active || !w)
+            return;
+        auto f = OpenGLDrawItem::func();
+        auto clear = [&] () {
+            f->glClearColor(target.color.redF(), target.color.greenF(),
+                            target.color.blueF(), target.color.alphaF());
+            f->glClear(GL_COLOR_BUFFER_BIT);
+        };
+        if (!target.frame || target.viewport.isEmpty()) {
+            clear();
+            return;
+        }
+        // mpv doesn't know about scissor test and may clear whole window,
+        // so render first without scissor and clear outside of video later
+        f->glDisable(GL_SCISSOR_TEST);
+        renderDirect(w->renderTargetId(), target.viewport, target.flip, target.redraw);
+        target.redraw = false;
+        const auto dpr = w->devicePixelRatio();
+        const QRect window(0, 0, qRound(w->width() * dpr),
+                           qRound(w->height() * dpr));
+        const auto &vp = target.viewport;
+        const QRect margins[] = {
+            { 0, 0, window.width(), vp.y() },
+            { 0, vp.bottom() + 1, window.width(), window.height() - vp.bottom() - 1 },
+            { 0, vp.y(), vp.x(), vp.height() },
+            { vp.right() + 1, vp.y(), window.width() - vp.right() - 1, vp.height() }
+        };
+        f->glEnable(GL_SCISSOR_TEST);
+        for (auto &margin : margins) {
+            const auto rect = margin & window;
+            if (rect.isEmpty())
+                continue;
+            f->glScissor(rect.x(), rect.y(), rect.width(), rect.height());
+            clear();
+        }
+        f->glDisable(GL_SCISSOR_TEST);
+        w->resetOpenGLState();
+    }
     auto updateFboSize(const QSize &size) -> void
     {
         if (_Change(fboSize, size)) {
@@ -121,6 +197,18 @@ VideoRenderer::VideoRenderer(QQuickItem *parent)
     });
     d->sizeChecker.setInterval(300);
     d->sizeChecker.setSingleShot(true);
+    connect(this, &QQuickItem::windowChanged, [this] (QQuickWindow *window) {
+        disconnect(d->beforeRendering);
+        if (d->window && d->direct)
+            d->window->setClearBeforeRendering(true);
+        d->window = window;
+        if (window) {
+            d->beforeRendering = connect(window, &QQuickWindow::beforeRendering,
+                this, [this] () { d->renderTarget(); }, Qt::DirectConnection);
+        }
+        d->direct = false;
+        d->updateDirect();
+    });
 }
 
 VideoRenderer::~VideoRenderer() {
@@ -132,6 +220,22 @@ auto VideoRenderer::setRenderFrameFunction(const RenderFrameFunc &func) -> void
     d->render = func;
 }
 
+auto VideoRenderer::setRenderDirectFunction(const RenderDirectFunc &func) -> void
+{
+    d->renderDirect = func;
+}
+
+auto VideoRenderer::setDirectRendering(bool direct) -> void
+{
+    if (_Change(d->directRequested, direct))
+        d->updateDirect();
+}
+
+auto VideoRenderer::isDirectRendering() const -> bool
+{
+    return d->direct;
+}
+
 auto VideoRenderer::updateForNewFrame(const QSize &displaySize) -> void
 {
     _PostEvent(Qt::HighEventPriority, this, NewFrame, displaySize);
@@ -177,6 +281,7 @@ auto VideoRenderer::customEvent(QEvent *event) -> void
             polish();
         }
         d->redraw = true;
+        d->updateDirect();
         reserve(UpdateMaterial);
         break;
     } default:
@@ -244,6 +349,7 @@ auto VideoRenderer::setAspectRatio(double ratio) -> void
 {
     if (!d->isSameRatio(d->aspect, ratio)) {
         d->aspect = ratio;
+        d->updateDirect();
         polish();
         reserve(UpdateGeometry);
     }
@@ -283,6 +389,7 @@ auto VideoRenderer::sizeHint() const -> QSize
 auto VideoRenderer::updatePolish() -> void
 {
     SimpleTextureItem::updatePolish();
+    d->updateDirect();
     QRectF letter;
     if (_Change(d->vtx, d->frameRect(geometry(), d->offset, &letter))) {
         d->sizeChecker.start();
@@ -298,13 +405,31 @@ auto VideoRenderer::updatePolish() -> void
 
 auto VideoRenderer::updateTexture(OpenGLTexture2D *texture) -> void
 {
+    auto w = window();
+    d->target.active = d->direct && w;
+    if (d->target.active) {
+        // called while main thread is blocked; render in beforeRendering()
+        const auto dpr = w->devicePixelRatio();
+        const auto rect = mapRectToScene(d->vtx);
+        d->target.viewport = QRect(qRound(rect.x() * dpr),
+                                   qRound((w->height() - rect.bottom()) * dpr),
+                                   qRound(rect.width() * dpr),
+                                   qRound(rect.height() * dpr));
+        d->target.flip = !d->flip_v;
+        d->target.color = w->color();
+        d->target.frame = hasFrame();
+        d->target.redraw |= d->redraw;
+        d->redraw = false;
+        _Delete(d->fbo);
+        *texture = d->black;
+        return;
+    }
     if (!d->redraw) {
         _Trace("VideoRendererItem::updateTexture(): no queued frame");
     } else if (!d->fboSize.isEmpty()) {
         d->redraw = false;
         if (!d->fbo || d->fbo->size() != d->fboSize)
             _Renew(d->fbo, d->fboSize);
-        auto w = window();
         if (w && d->render) {
             w->resetOpenGLState();
             d->render(d->fbo);
@@ -316,6 +441,10 @@ auto VideoRenderer::updateTexture(OpenGLTexture2D *texture) -> void
 
 auto VideoRenderer::updateVertex(Vertex *vertex) -> void
 {
+    if (d->direct) { // nothing to draw over video in framebuffer
+        Vertex::fillAsTriangleStrip(vertex, {0, 0}, {0, 0}, {0, 0}, {1, 1});
+        return;
+    }
     double top = 0.0, left = 0.0, right = 1.0, bottom = 1.0;
     if (d->flip_v)
         std::swap(top, bottom);
@@ -327,8 +456,10 @@ auto VideoRenderer::updateVertex(Vertex *vertex) -> void
 
 auto VideoRenderer::setFlipped(bool horizontal, bool vertical) -> void
 {
-    if (_Change(d->flip_h, horizontal) | _Change(d->flip_v, vertical))
-        reserve(UpdateGeometry);
+    if (_Change(d->flip_h, horizontal) | _Change(d->flip_v, vertical)) {
+        d->updateDirect();
+        reserve(UpdateAll);
+    }
 }
 
 auto VideoRenderer::mapToVideo(const QPointF &pos) -> QPointF
@@ -6,6 +6,9 @@
 
 class OpenGLFramebufferObject;
 using RenderFrameFunc = std::function<void(OpenGLFramebufferObject*)>;
+// renders into viewport of fbo; redraw is false if no new frame is queued
+using RenderDirectFunc = std::function<void(GLuint fbo, const QRect &viewport,
+                                            bool flip, bool redraw)>;
 
 class VideoRenderer : public SimpleTextureItem {
     Q_OBJECT
@@ -32,6 +35,11 @@ public:
     auto setOffset(const QPoint &offset) -> void;
     auto setCropRatio(double ratio) -> void;
     auto setRenderFrameFunction(const RenderFrameFunc &func) -> void;
+    auto setRenderDirectFunction(const RenderDirectFunc &func) -> void;
+    // renders video into window framebuffer without intermediate fbo
+    // unless transformation of item requires texture
+    auto setDirectRendering(bool direct) -> void;
+    auto isDirectRendering() const -> bool;
     auto updateForNewFrame(const QSize &displaySize) -> void;
 signals:
     void offsetChanged(const QPoint &pos);
@@ -34,6 +34,8 @@
 #include "common/msg.h"
 #include "common/global.h"
 #include "osdep/threads.h"
+#include "osdep/atomics.h"
+#include "misc/ring.h"
 
 #include "stream/stream.h"
 #include "demux.h"
@@ -91,8 +93,10 @@ struct demux_internal {
     struct demuxer *d_user;     // accessed by player (consumer)
     struct demuxer *d_buffer;   // protected by lock; used to sync d_user/thread
 
-    // The lock protects the packet queues (struct demux_stream), d_buffer,
-    // and some minor fields like thread_paused.
+    // The lock protects the stream state (struct demux_stream), d_buffer,
+    // and some minor fields like thread_paused. The packet queues themselves
+    // are single-producer/single-consumer rings, and the player takes the
+    // lock only when a queue runs dry or the demux thread asked for wakeup.
     pthread_mutex_t lock;
     pthread_cond_t wakeup;
     pthread_t thread;
@@ -133,28 +137,43 @@ struct demux_internal {
     int64_t stream_cache_size;
     int64_t stream_cache_fill;
     int stream_cache_idle;
+    struct stream_cache_stats stream_cache_stats;
+    bool has_stream_cache_stats;
     // Updated during init only.
     char *stream_base_filename;
 };
 
+// Number of packets each stream queue holds before spilling to the overflow
+// list. Packets beyond this are still accepted, but make the stream count as
+// full for readahead purposes.
+#define QUEUE_PACKS 1024
+
 struct demux_stream {
     struct demux_internal *in;
     enum stream_type type;
-    // all fields are protected by in->lock
+    // the following fields are protected by in->lock
     bool selected;          // user wants packets from this stream
     bool active;            // try to keep at least 1 packet queued
     bool eof;               // end of demuxed stream? (true if all buffer empty)
     bool refreshing;
-    size_t packs;           // number of packets in buffer
-    size_t bytes;           // total bytes of packets in buffer
-    double base_ts;         // timestamp of the last packet returned to decoder
+    double base_ts;         // last read_ts published by the consumer
     double last_ts;         // timestamp of the last packet added to queue
+    int64_t last_pos;
+    // packets which didn't fit into the queue, moved there in order later
+    struct demux_packet *overflow;
+    struct demux_packet *overflow_tail;
+    // lock-free packet queue: written by the demux thread (or by anyone
+    // holding in->lock), read by the player without the lock
+    struct mp_ring *queue;  // of struct demux_packet pointers
+    atomic_ulong packs;     // number of packets in buffer (incl. overflow)
+    atomic_ulong bytes;     // total bytes of packets in buffer
+    // the consumer wakes up the idle demux thread if packs drops to this
+    atomic_ulong low_water;
+    // only accessed by the consumer (player thread)
+    double read_ts;         // timestamp of the last packet returned to decoder
     double last_br_ts;      // timestamp of last packet bitrate was calculated
     size_t last_br_bytes;   // summed packet sizes since last bitrate calculation
     double bitrate;
-    int64_t last_pos;
-    struct demux_packet *head;
-    struct demux_packet *tail;
 };
 
 // Return "a", or if that is NOPTS, return "def".
@@ -167,19 +186,49 @@ static void demuxer_sort_chapters(demuxer_t *demuxer);
 static void *demux_thread(void *pctx);
 static void update_cache(struct demux_internal *in);
 
-// called locked
+static size_t ds_packs(struct demux_stream *ds)
+{
+    return atomic_load(&ds->packs);
+}
+
+// called locked; moves packets from the overflow list to the queue
+static void ds_refill(struct demux_stream *ds)
+{
+    while (ds->overflow && mp_ring_available(ds->queue) >= sizeof(void *)) {
+        struct demux_packet *dp = ds->overflow;
+        ds->overflow = dp->next;
+        if (!ds->overflow)
+            ds->overflow_tail = NULL;
+        dp->next = NULL;
+        mp_ring_write(ds->queue, (unsigned char *)&dp, sizeof(dp));
+    }
+}
+
+// called locked by the consumer; makes read_ts visible to the demux thread
+static void ds_publish(struct demux_stream *ds)
+{
+    if (ds->read_ts != MP_NOPTS_VALUE)
+        ds->base_ts = ds->read_ts;
+}
+
+// called locked by the consumer (or when the demux thread is not running)
 static void ds_flush(struct demux_stream *ds)
 {
-    demux_packet_t *dp = ds->head;
+    struct demux_packet *dp;
+    while (mp_ring_read(ds->queue, (unsigned char *)&dp, sizeof(dp)) == sizeof(dp))
+        free_demux_packet(dp);
+    dp = ds->overflow;
     while (dp) {
         demux_packet_t *dn = dp->next;
         free_demux_packet(dp);
         dp = dn;
     }
-    ds->head = ds->tail = NULL;
-    ds->packs = 0;
-    ds->bytes = 0;
-    ds->last_ts = ds->base_ts = ds->last_br_ts = MP_NOPTS_VALUE;
+    ds->overflow = ds->overflow_tail = NULL;
+    mp_ring_reset(ds->queue);
+    atomic_store(&ds->packs, 0);
+    atomic_store(&ds->bytes, 0);
+    atomic_store(&ds->low_water, 0);
+    ds->last_ts = ds->base_ts = ds->read_ts = ds->last_br_ts = MP_NOPTS_VALUE;
     ds->last_br_bytes = 0;
     ds->bitrate = -1;
     ds->eof = false;
@@ -215,6 +264,16 @@ struct sh_stream *new_sh_stream(demuxer_t *demuxer, enum stream_type type)
         .in = demuxer->in,
         .type = sh->type,
         .selected = demuxer->in->autoselect,
+        .queue = mp_ring_new(sh, QUEUE_PACKS * sizeof(struct demux_packet *)),
+        .packs = ATOMIC_VAR_INIT(0),
+        .bytes = ATOMIC_VAR_INIT(0),
+        .low_water = ATOMIC_VAR_INIT(0),
+        .base_ts = MP_NOPTS_VALUE,
+        .last_ts = MP_NOPTS_VALUE,
+        .read_ts = MP_NOPTS_VALUE,
+        .last_br_ts = MP_NOPTS_VALUE,
+        .bitrate = -1,
+        .last_pos = -1,
     };
     MP_TARRAY_APPEND(demuxer, demuxer->streams, demuxer->num_streams, sh);
     switch (sh->type) {
@@ -324,20 +383,6 @@ int demux_add_packet(struct sh_stream *stream, demux_packet_t *dp)
     dp->next = NULL;
 
     ds->last_pos = dp->pos;
-    ds->packs++;
-    ds->bytes += dp->len;
-    if (ds->tail) {
-        // next packet in stream
-        ds->tail->next = dp;
-        ds->tail = dp;
-    } else {
-        // first packet in stream
-        ds->head = ds->tail = dp;
-    }
-
-    // obviously not true anymore
-    ds->eof = false;
-    in->last_eof = in->eof = false;
 
     // For video, PTS determination is not trivial, but for other media types
     // distinguishing PTS and DTS is not useful.
@@ -350,17 +395,49 @@ int demux_add_packet(struct sh_stream *stream, demux_packet_t *dp)
     if (ds->base_ts == MP_NOPTS_VALUE)
         ds->base_ts = ds->last_ts;
 
+    // Count the packet before publishing it, so that the consumer never sees
+    // more packets than accounted for.
+    bool was_empty = atomic_fetch_add(&ds->packs, 1) == 0;
+    atomic_fetch_add(&ds->bytes, dp->len);
+
     MP_DBG(in, "append packet to %s: size=%d pts=%f dts=%f pos=%"PRIi64" "
            "[num=%zd size=%zd]\n", stream_type_name(stream->type),
-           dp->len, dp->pts, dp->dts, dp->pos, ds->packs, ds->bytes);
+           dp->len, dp->pts, dp->dts, dp->pos, ds_packs(ds),
+           (size_t)atomic_load(&ds->bytes));
+
+    // dp is owned by the consumer as soon as it's in the queue
+    ds_refill(ds);
+    if (!ds->overflow && mp_ring_available(ds->queue) >= sizeof(dp)) {
+        mp_ring_write(ds->queue, (unsigned char *)&dp, sizeof(dp));
+    } else if (ds->overflow_tail) {
+        ds->overflow_tail->next = dp;
+        ds->overflow_tail = dp;
+    } else {
+        ds->overflow = ds->overflow_tail = dp;
+    }
 
-    if (ds->in->wakeup_cb && !ds->head->next)
+    // obviously not true anymore
+    ds->eof = false;
+    in->last_eof = in->eof = false;
+
+    if (ds->in->wakeup_cb && was_empty)
         ds->in->wakeup_cb(ds->in->wakeup_cb_ctx);
     pthread_cond_signal(&in->wakeup);
     pthread_mutex_unlock(&in->lock);
     return 1;
 }
 
+// Called locked by the demux thread before it goes idle. The consumer doesn't
+// take the lock for each packet, so tell it when it should wake us up again:
+// once half of the queued packets are gone, or the queue ran empty.
+static void set_low_water(struct demux_internal *in)
+{
+    for (int n = 0; n < in->d_buffer->num_streams; n++) {
+        struct demux_stream *ds = in->d_buffer->streams[n]->ds;
+        atomic_store(&ds->low_water, ds_packs(ds) / 2);
+    }
+}
+
 // Returns true if there was "progress" (lock was released temporarily).
 static bool read_packet(struct demux_internal *in)
 {
@@ -369,20 +446,25 @@ static bool read_packet(struct demux_internal *in)
 
     // Check if we need to read a new packet. We do this if all queues are below
     // the minimum, or if a stream explicitly needs new packets. Also includes
-    // safe-guards against packet queue overflow.
-    bool active = false, read_more = false;
+    // safe-guards against packet queue overflow. A stream whose queue spilled
+    // over is full, and only a starving stream can make us read past that.
+    bool active = false, read_more = false, full = false;
     size_t packs = 0, bytes = 0;
     for (int n = 0; n < in->d_buffer->num_streams; n++) {
         struct demux_stream *ds = in->d_buffer->streams[n]->ds;
+        ds_refill(ds);
+        size_t ds_packets = ds_packs(ds);
         active |= ds->active;
-        read_more |= ds->active && !ds->head;
-        packs += ds->packs;
-        bytes += ds->bytes;
-        if (ds->active && ds->last_ts != MP_NOPTS_VALUE && in->min_secs > 0)
+        read_more |= ds->active && !ds_packets;
+        full |= ds->active && ds->overflow;
+        packs += ds_packets;
+        bytes += atomic_load(&ds->bytes);
+        if (ds->active && ds->last_ts != MP_NOPTS_VALUE && in->min_secs > 0 &&
+            !ds->overflow)
             read_more |= ds->last_ts - ds->base_ts < in->min_secs;
     }
-    MP_DBG(in, "packets=%zd, bytes=%zd, active=%d, more=%d\n",
-           packs, bytes, active, read_more);
+    MP_DBG(in, "packets=%zd, bytes=%zd, active=%d, more=%d, full=%d\n",
+           packs, bytes, active, read_more, full);
     if (packs >= MAX_PACKS || bytes >= MAX_PACK_BYTES) {
         if (!in->warned_queue_overflow) {
             in->warned_queue_overflow = true;
@@ -391,26 +473,33 @@ static bool read_packet(struct demux_internal *in)
                 struct demux_stream *ds = in->d_buffer->streams[n]->ds;
                 if (ds->selected) {
                     MP_ERR(in, "  %s/%d: %zd packets, %zd bytes\n",
-                           stream_type_name(ds->type), n, ds->packs, ds->bytes);
+                           stream_type_name(ds->type), n, ds_packs(ds),
+                           (size_t)atomic_load(&ds->bytes));
                 }
             }
         }
         for (int n = 0; n < in->d_buffer->num_streams; n++) {
             struct demux_stream *ds = in->d_buffer->streams[n]->ds;
-            ds->eof |= !ds->head;
+            ds->eof |= !ds_packs(ds);
         }
+        set_low_water(in);
         pthread_cond_signal(&in->wakeup);
         return false;
     }
-    if (packs < in->min_packs && bytes < in->min_bytes)
+    if (packs < in->min_packs && bytes < in->min_bytes && !full)
         read_more |= active;
 
-    if (!read_more)
+    if (!read_more) {
+        set_low_water(in);
         return false;
+    }
 
     // Actually read a packet. Drop the lock while doing so, because waiting
-    // for disk or network I/O can take time.
+    // for disk or network I/O can take time. Meanwhile the consumer needs to
+    // wake us only if a queue runs empty.
     in->idle = false;
+    for (int n = 0; n < in->d_buffer->num_streams; n++)
+        atomic_store(&in->d_buffer->streams[n]->ds->low_water, 0);
     pthread_mutex_unlock(&in->lock);
     struct demuxer *demux = in->d_thread;
     bool eof = !demux->desc->fill_buffer || demux->desc->fill_buffer(demux) <= 0;
@@ -443,7 +532,8 @@ static void ds_get_packets(struct demux_stream *ds)
     MP_DBG(in, "reading packet for %s\n", t);
     in->eof = false; // force retry
     ds->eof = false;
-    while (ds->selected && !ds->head && !ds->eof) {
+    ds_publish(ds);
+    while (ds->selected && !ds_packs(ds) && !ds->eof) {
         ds->active = true;
         // Note: the following code marks EOF if it can't continue
         if (in->threading) {
@@ -560,21 +650,19 @@ static void *demux_thread(void *pctx)
     return NULL;
 }
 
+// Called by the consumer; doesn't need the lock, unless the demux thread may be
+// running and the queue has to be refilled from the overflow list.
 static struct demux_packet *dequeue_packet(struct demux_stream *ds)
 {
-    if (!ds->head)
+    struct demux_packet *pkt;
+    if (mp_ring_read(ds->queue, (unsigned char *)&pkt, sizeof(pkt)) < sizeof(pkt))
         return NULL;
-    struct demux_packet *pkt = ds->head;
-    ds->head = pkt->next;
-    pkt->next = NULL;
-    if (!ds->head)
-        ds->tail = NULL;
-    ds->bytes -= pkt->len;
-    ds->packs--;
+    atomic_fetch_add(&ds->bytes, -(unsigned long)pkt->len);
+    atomic_fetch_add(&ds->packs, -1UL);
 
     double ts = pkt->dts == MP_NOPTS_VALUE ? pkt->pts : pkt->dts;
     if (ts != MP_NOPTS_VALUE)
-        ds->base_ts = ts;
+        ds->read_ts = ts;
 
     if (pkt->keyframe) {
         // Update bitrate - only at keyframe points, because we use the
@@ -599,6 +687,22 @@ static struct demux_packet *dequeue_packet(struct demux_stream *ds)
     return pkt;
 }
 
+// Lock-free fast path of the readers: returns a queued packet if there is one,
+// and the demux thread doesn't need to be woken up to keep reading ahead.
+static struct demux_packet *try_dequeue_packet(struct demux_stream *ds)
+{
+    if (!ds->in->threading)
+        return NULL;
+    struct demux_packet *pkt = dequeue_packet(ds);
+    if (pkt && ds_packs(ds) <= atomic_load(&ds->low_water)) {
+        pthread_mutex_lock(&ds->in->lock);
+        ds_publish(ds);
+        pthread_cond_signal(&ds->in->wakeup); // read more
+        pthread_mutex_unlock(&ds->in->lock);
+    }
+    return pkt;
+}
+
 // Read a packet from the given stream. The returned packet belongs to the
 // caller, who has to free it with talloc_free(). Might block. Returns NULL
 // on EOF.
@@ -607,9 +711,14 @@ struct demux_packet *demux_read_packet(struct sh_stream *sh)
     struct demux_stream *ds = sh ? sh->ds : NULL;
     struct demux_packet *pkt = NULL;
     if (ds) {
+        pkt = try_dequeue_packet(ds);
+        if (pkt)
+            return pkt;
         pthread_mutex_lock(&ds->in->lock);
         ds_get_packets(ds);
+        ds_refill(ds);
         pkt = dequeue_packet(ds);
+        ds_publish(ds);
         pthread_cond_signal(&ds->in->wakeup); // possibly read more
         pthread_mutex_unlock(&ds->in->lock);
     }
@@ -632,11 +741,17 @@ int demux_read_packet_async(struct sh_stream *sh, struct demux_packet **out_pkt)
     *out_pkt = NULL;
     if (ds) {
         if (ds->in->threading) {
+            // Readahead was enabled when the queue last ran empty.
+            *out_pkt = try_dequeue_packet(ds);
+            if (*out_pkt)
+                return 1;
             pthread_mutex_lock(&ds->in->lock);
+            ds_refill(ds);
             *out_pkt = dequeue_packet(ds);
             r = *out_pkt ? 1 : ((ds->eof || !ds->selected) ? -1 : 0);
             ds->active = ds->selected; // enable readahead
             ds->in->eof = false; // force retry
+            ds_publish(ds);
             pthread_cond_signal(&ds->in->wakeup); // possibly read more
             pthread_mutex_unlock(&ds->in->lock);
         } else {
@@ -654,11 +769,14 @@ double demux_get_next_pts(struct sh_stream *sh)
 {
     double res = MP_NOPTS_VALUE;
     if (sh) {
-        pthread_mutex_lock(&sh->ds->in->lock);
-        ds_get_packets(sh->ds);
-        if (sh->ds->head)
-            res = sh->ds->head->pts;
-        pthread_mutex_unlock(&sh->ds->in->lock);
+        struct demux_stream *ds = sh->ds;
+        pthread_mutex_lock(&ds->in->lock);
+        ds_get_packets(ds);
+        ds_refill(ds);
+        struct demux_packet *pkt;
+        if (mp_ring_peek(ds->queue, (unsigned char *)&pkt, sizeof(pkt)) == sizeof(pkt))
+            res = pkt->pts;
+        pthread_mutex_unlock(&ds->in->lock);
     }
     return res;
 }
@@ -666,13 +784,7 @@ double demux_get_next_pts(struct sh_stream *sh)
 // Return whether a packet is queued. Never blocks, never forces any reads.
 bool demux_has_packet(struct sh_stream *sh)
 {
-    bool has_packet = false;
-    if (sh) {
-        pthread_mutex_lock(&sh->ds->in->lock);
-        has_packet = sh->ds->head;
-        pthread_mutex_unlock(&sh->ds->in->lock);
-    }
-    return has_packet;
+    return sh && ds_packs(sh->ds);
 }
 
 // Read and return any packet we find.
@@ -684,6 +796,7 @@ struct demux_packet *demux_read_any_packet(struct demuxer *demuxer)
         for (int n = 0; n < demuxer->num_streams; n++) {
             struct sh_stream *sh = demuxer->streams[n];
             sh->ds->active = sh->ds->selected; // force read_packet() to read
+            ds_refill(sh->ds);
             struct demux_packet *pkt = dequeue_packet(sh->ds);
             if (pkt)
                 return pkt;
@@ -1236,6 +1349,7 @@ static void update_cache(struct demux_internal *in)
     int64_t stream_cache_size = -1;
     int64_t stream_cache_fill = -1;
     int stream_cache_idle = -1;
+    struct stream_cache_stats stream_cache_stats = {0};
     struct mp_nav_event *nav_event = NULL;
 
     pthread_mutex_lock(&in->lock);
@@ -1254,6 +1368,9 @@ static void update_cache(struct demux_internal *in)
     stream_control(stream, STREAM_CTRL_GET_CACHE_SIZE, &stream_cache_size);
     stream_control(stream, STREAM_CTRL_GET_CACHE_FILL, &stream_cache_fill);
     stream_control(stream, STREAM_CTRL_GET_CACHE_IDLE, &stream_cache_idle);
+    bool has_stream_cache_stats =
+        stream_control(stream, STREAM_CTRL_GET_CACHE_STATS,
+                       &stream_cache_stats) == STREAM_OK;
 
     pthread_mutex_lock(&in->lock);
     in->time_length = time_length;
@@ -1261,6 +1378,8 @@ static void update_cache(struct demux_internal *in)
     in->stream_cache_size = stream_cache_size;
     in->stream_cache_fill = stream_cache_fill;
     in->stream_cache_idle = stream_cache_idle;
+    in->stream_cache_stats = stream_cache_stats;
+    in->has_stream_cache_stats = has_stream_cache_stats;
     if (stream_metadata) {
         talloc_free(in->stream_metadata);
         in->stream_metadata = talloc_steal(in, stream_metadata);
@@ -1295,6 +1414,11 @@ static int cached_stream_control(struct demux_internal *in, int cmd, void *arg)
             return STREAM_UNSUPPORTED;
         *(int *)arg = in->stream_cache_idle;
         return STREAM_OK;
+    case STREAM_CTRL_GET_CACHE_STATS:
+        if (!in->has_stream_cache_stats)
+            return STREAM_UNSUPPORTED;
+        *(struct stream_cache_stats *)arg = in->stream_cache_stats;
+        return STREAM_OK;
     case STREAM_CTRL_GET_SIZE:
         if (in->stream_size < 0)
             return STREAM_UNSUPPORTED;
@@ -1350,13 +1474,14 @@ static int cached_demux_control(struct demux_internal *in, int cmd, void *arg)
         int num_packets = 0;
         for (int n = 0; n < in->d_user->num_streams; n++) {
             struct demux_stream *ds = in->d_user->streams[n]->ds;
+            ds_publish(ds);
             if (ds->active) {
-                r->underrun |= !ds->head && !ds->eof;
+                r->underrun |= !ds_packs(ds) && !ds->eof;
                 if (!ds->eof) {
                     r->ts_range[0] = MP_PTS_MAX(r->ts_range[0], ds->base_ts);
                     r->ts_range[1] = MP_PTS_MIN(r->ts_range[1], ds->last_ts);
                 }
-                num_packets += ds->packs;
+                num_packets += ds_packs(ds);
             }
         }
         r->idle = (in->idle && !r->underrun) || r->eof;
@@ -23,9 +23,15 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <inttypes.h>
 #include <stdbool.h>
 #include <assert.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <utime.h>
 
 #include <libavutil/common.h>
 #include <libavutil/lzo.h>
@@ -44,6 +50,7 @@
 #include "talloc.h"
 #include "common/av_common.h"
 #include "options/options.h"
+#include "options/path.h"
 #include "misc/bstr.h"
 #include "stream/stream.h"
 #include "video/csputils.h"
@@ -182,6 +189,15 @@ typedef struct mkv_demuxer {
     int subtitle_preroll;
 
     bool index_has_durations;
+    bool index_gap;         // clusters were skipped by a byte seek
+
+    // persisted index (--demuxer-mkv-index-cache-dir)
+    char *index_cache;      // file name, NULL if not used
+    char *index_cache_dir;
+    const char *index_cache_path; // path of the played file
+    int64_t index_cache_size, index_cache_mtime;
+    size_t index_cache_saved; // number of entries the file already has
+    bool index_cache_complete;
 } mkv_demuxer_t;
 
 #define REALHEADER_SIZE    16
@@ -769,6 +785,290 @@ static void read_deferred_cues(demuxer_t *demuxer)
     }
 }
 
+#define INDEX_CACHE_MAGIC "mkvidx01"
+
+#define INDEX_CACHE_COMPLETE  (1 << 0) // like mkv_demuxer.index_complete
+#define INDEX_CACHE_DURATIONS (1 << 1) // like mkv_demuxer.index_has_durations
+
+// Index cache file layout: header, path (path_len bytes, no terminator),
+// num_indexes entries. Native byte order; it's never shared between hosts.
+struct index_cache_header {
+    char magic[8];
+    uint64_t size;
+    int64_t mtime;
+    uint64_t tc_scale;
+    uint64_t segment_start;
+    uint32_t flags;
+    uint32_t path_len;
+    uint64_t num_indexes;
+};
+
+struct index_cache_entry {
+    uint64_t tnum, timecode, duration, filepos;
+};
+
+static uint64_t hash_path(const char *path)
+{
+    // FNV-1a
+    uint64_t h = 14695981039346656037ULL;
+    for (const char *c = path; *c; c++)
+        h = (h ^ (uint8_t)*c) * 1099511628211ULL;
+    return h;
+}
+
+// Seeking uses the entries of the video track, so only these are persisted.
+// Without video, the entries of all tracks are.
+static bool index_cache_keeps(mkv_demuxer_t *mkv_d, uint64_t tnum)
+{
+    bool has_video = false;
+    for (int n = 0; n < mkv_d->num_tracks; n++) {
+        mkv_track_t *track = mkv_d->tracks[n];
+        if (track->type == MATROSKA_TRACK_VIDEO) {
+            if (track->tnum == tnum)
+                return true;
+            has_video = true;
+        }
+    }
+    return !has_video;
+}
+
+static bool read_index_cache(demuxer_t *demuxer, FILE *f)
+{
+    mkv_demuxer_t *mkv_d = demuxer->priv;
+    const char *path = mkv_d->index_cache_path;
+
+    struct stat st;
+    if (fstat(fileno(f), &st) != 0)
+        return false;
+
+    struct index_cache_header h;
+    if (fread(&h, sizeof(h), 1, f) != 1)
+        return false;
+    // don't trust num_indexes of a corrupt file for the allocation below
+    int64_t entries_size = st.st_size - (int64_t)sizeof(h) - h.path_len;
+    if (entries_size < 0 ||
+        h.num_indexes > entries_size / sizeof(struct index_cache_entry) ||
+        memcmp(h.magic, INDEX_CACHE_MAGIC, sizeof(h.magic)) != 0 ||
+        h.size != mkv_d->index_cache_size ||
+        h.mtime != mkv_d->index_cache_mtime ||
+        h.tc_scale != mkv_d->tc_scale ||
+        h.segment_start != mkv_d->segment_start ||
+        h.path_len != strlen(path) || h.num_indexes == 0)
+        return false;
+
+    char *name = talloc_size(NULL, h.path_len);
+    bool ok = fread(name, h.path_len, 1, f) == 1 &&
+              memcmp(name, path, h.path_len) == 0;
+    talloc_free(name);
+    if (!ok)
+        return false;
+
+    struct index_cache_entry *entries =
+        talloc_array(NULL, struct index_cache_entry, h.num_indexes);
+    if (fread(entries, sizeof(entries[0]), h.num_indexes, f) != h.num_indexes) {
+        talloc_free(entries);
+        return false;
+    }
+    mkv_d->num_indexes = 0;
+    for (size_t i = 0; i < h.num_indexes; i++) {
+        cue_index_add(demuxer, entries[i].tnum, entries[i].filepos,
+                      entries[i].timecode, entries[i].duration);
+    }
+    talloc_free(entries);
+
+    mkv_d->index_complete = h.flags & INDEX_CACHE_COMPLETE;
+    mkv_d->index_has_durations = h.flags & INDEX_CACHE_DURATIONS;
+    if (mkv_d->index_complete) {
+        // The cues were already read into the cache.
+        mkv_d->deferred_cues = 0;
+    } else {
+        // Continue indexing after the cached entries.
+        for (int n = 0; n < mkv_d->num_tracks; n++) {
+            mkv_track_t *track = mkv_d->tracks[n];
+            for (size_t i = 0; i < mkv_d->num_indexes; i++) {
+                if (mkv_d->indexes[i].tnum == track->tnum)
+                    track->last_index_entry = i;
+            }
+        }
+    }
+    return true;
+}
+
+// Load the index persisted for this file by a previous session, if any.
+static void open_index_cache(demuxer_t *demuxer)
+{
+    struct MPOpts *opts = demuxer->opts;
+    mkv_demuxer_t *mkv_d = demuxer->priv;
+    stream_t *s = demuxer->stream;
+    if (s->uncached_stream)
+        s = s->uncached_stream;
+
+    if (!opts->mkv_index_cache_dir || !opts->mkv_index_cache_dir[0] ||
+        opts->index_mode != 1 || strcmp(s->info->name, "file") != 0 ||
+        !s->path || !demuxer->seekable)
+        return;
+
+    // Cues in front of the clusters were read with the headers already.
+    if (mkv_d->index_complete)
+        return;
+
+    struct stat st;
+    if (stat(s->path, &st) != 0 || !S_ISREG(st.st_mode))
+        return;
+
+    mkv_d->index_cache_path = talloc_strdup(mkv_d, s->path);
+    mkv_d->index_cache_size = st.st_size;
+    mkv_d->index_cache_mtime = st.st_mtime;
+    mkv_d->index_cache_dir =
+        mp_get_user_path(mkv_d, demuxer->global, opts->mkv_index_cache_dir);
+    char name[32];
+    snprintf(name, sizeof(name), "%016" PRIx64 ".idx", hash_path(s->path));
+    mkv_d->index_cache =
+        mp_path_join(mkv_d, bstr0(mkv_d->index_cache_dir), bstr0(name));
+
+    FILE *f = fopen(mkv_d->index_cache, "rb");
+    if (!f)
+        return;
+    if (read_index_cache(demuxer, f)) {
+        mkv_d->index_cache_saved = mkv_d->num_indexes;
+        mkv_d->index_cache_complete = mkv_d->index_complete;
+        utime(mkv_d->index_cache, NULL); // for eviction of least recently used
+        MP_VERBOSE(demuxer, "Loaded %zd %s index entries from %s\n",
+                   mkv_d->num_indexes,
+                   mkv_d->index_complete ? "complete" : "partial",
+                   mkv_d->index_cache);
+    } else {
+        mkv_d->num_indexes = 0;
+        mkv_d->index_complete = false;
+        mkv_d->index_has_durations = false;
+        MP_VERBOSE(demuxer, "Ignoring stale index cache %s\n",
+                   mkv_d->index_cache);
+    }
+    fclose(f);
+}
+
+struct index_cache_file {
+    char *path;
+    time_t mtime;
+    int64_t size;
+};
+
+static int cmp_mtime(const void *a, const void *b)
+{
+    const struct index_cache_file *f1 = a, *f2 = b;
+    return f1->mtime < f2->mtime ? -1 : (f1->mtime > f2->mtime ? 1 : 0);
+}
+
+// Remove least recently used indexes until the directory fits into budget.
+static void evict_index_cache(demuxer_t *demuxer, int64_t budget)
+{
+    mkv_demuxer_t *mkv_d = demuxer->priv;
+    const char *dir = mkv_d->index_cache_dir;
+    DIR *d = opendir(dir);
+    if (!d)
+        return;
+    void *tmp = talloc_new(NULL);
+    struct index_cache_file *files = NULL;
+    int num_files = 0;
+    int64_t total = 0;
+    struct dirent *de;
+    while ((de = readdir(d))) {
+        if (!bstr_endswith0(bstr0(de->d_name), ".idx"))
+            continue;
+        char *path = mp_path_join(tmp, bstr0(dir), bstr0(de->d_name));
+        struct stat st;
+        if (stat(path, &st) != 0)
+            continue;
+        struct index_cache_file file = {path, st.st_mtime, st.st_size};
+        MP_TARRAY_APPEND(tmp, files, num_files, file);
+        total += st.st_size;
+    }
+    closedir(d);
+    qsort(files, num_files, sizeof(files[0]), cmp_mtime);
+    for (int n = 0; n < num_files && total > budget; n++) {
+        if (strcmp(files[n].path, mkv_d->index_cache) == 0)
+            continue;
+        if (unlink(files[n].path) == 0) {
+            total -= files[n].size;
+            MP_VERBOSE(demuxer, "Removed index cache %s\n", files[n].path);
+        }
+    }
+    talloc_free(tmp);
+}
+
+// Write the index back if it grew. Partial indexes are kept only if they were
+// built contiguously from the start of the file, so that indexing can resume.
+static void save_index_cache(demuxer_t *demuxer)
+{
+    mkv_demuxer_t *mkv_d = demuxer->priv;
+
+    if (!mkv_d->index_cache || !mkv_d->num_indexes ||
+        (mkv_d->index_gap && !mkv_d->index_complete))
+        return;
+    size_t num_indexes = 0;
+    for (size_t i = 0; i < mkv_d->num_indexes; i++)
+        num_indexes += index_cache_keeps(mkv_d, mkv_d->indexes[i].tnum);
+    if (!num_indexes ||
+        (num_indexes == mkv_d->index_cache_saved &&
+         mkv_d->index_complete == mkv_d->index_cache_complete))
+        return;
+
+    struct index_cache_header h = {
+        .size = mkv_d->index_cache_size,
+        .mtime = mkv_d->index_cache_mtime,
+        .tc_scale = mkv_d->tc_scale,
+        .segment_start = mkv_d->segment_start,
+        .flags = (mkv_d->index_complete ? INDEX_CACHE_COMPLETE : 0) |
+                 (mkv_d->index_has_durations ? INDEX_CACHE_DURATIONS : 0),
+        .path_len = strlen(mkv_d->index_cache_path),
+        .num_indexes = num_indexes,
+    };
+    memcpy(h.magic, INDEX_CACHE_MAGIC, sizeof(h.magic));
+
+    mp_mkdirp(mkv_d->index_cache_dir);
+    char *tmp = talloc_asprintf(NULL, "%s.tmp", mkv_d->index_cache);
+    FILE *f = fopen(tmp, "wb");
+    bool ok = f && fwrite(&h, sizeof(h), 1, f) == 1 &&
+              fwrite(mkv_d->index_cache_path, h.path_len, 1, f) == 1;
+    for (size_t i = 0; ok && i < mkv_d->num_indexes; i++) {
+        struct mkv_index *index = &mkv_d->indexes[i];
+        if (!index_cache_keeps(mkv_d, index->tnum))
+            continue;
+        struct index_cache_entry e = {
+            .tnum = index->tnum,
+            .timecode = index->timecode,
+            .duration = index->duration,
+            .filepos = index->filepos,
+        };
+        ok = fwrite(&e, sizeof(e), 1, f) == 1;
+    }
+    if (f)
+        ok &= fclose(f) == 0;
+    if (ok && rename(tmp, mkv_d->index_cache) == 0) {
+        MP_VERBOSE(demuxer, "Saved %zd index entries to %s\n",
+                   num_indexes, mkv_d->index_cache);
+        evict_index_cache(demuxer, demuxer->opts->mkv_index_cache_max * 1024LL);
+    } else {
+        MP_WARN(demuxer, "Can't write index cache %s\n", mkv_d->index_cache);
+        unlink(tmp);
+    }
+    talloc_free(tmp);
+}
+
+// Called when reading hit the end of the file. If every cluster was seen on
+// the way, the index built from the blocks is as good as cues.
+static void index_reached_eof(demuxer_t *demuxer)
+{
+    mkv_demuxer_t *mkv_d = demuxer->priv;
+
+    if (!mkv_d->index_complete && !mkv_d->index_gap && !mkv_d->deferred_cues &&
+        mkv_d->num_indexes && mkv_d->index_cache)
+    {
+        MP_VERBOSE(demuxer, "Index complete after reading the whole file.\n");
+        mkv_d->index_complete = true;
+    }
+}
+
 static int demux_mkv_read_chapters(struct demuxer *demuxer)
 {
     struct MPOpts *opts = demuxer->opts;
@@ -1839,6 +2139,8 @@ static int demux_mkv_open(demuxer_t *demuxer, enum demux_check check)
     add_coverart(demuxer);
     demuxer->allow_refresh_seeks = true;
 
+    open_index_cache(demuxer);
+
     if (demuxer->opts->mkv_probe_duration)
         probe_last_timestamp(demuxer);
 
@@ -2553,8 +2855,10 @@ static int demux_mkv_fill_buffer(demuxer_t *demuxer)
         int res;
         struct block_info block;
         res = read_next_block(demuxer, &block);
-        if (res < 0)
+        if (res < 0) {
+            index_reached_eof(demuxer);
             return 0;
+        }
         if (res > 0) {
             index_block(demuxer, &block);
             res = handle_block(demuxer, &block);
@@ -2602,8 +2906,10 @@ static int create_index_until(struct demuxer *demuxer, uint64_t timecode)
             int res;
             struct block_info block;
             res = read_next_block(demuxer, &block);
-            if (res < 0)
+            if (res < 0) {
+                index_reached_eof(demuxer);
                 break;
+            }
             if (res > 0) {
                 index_block(demuxer, &block);
                 free_block(&block);
@@ -2779,6 +3085,8 @@ static void demux_mkv_seek(demuxer_t *demuxer, double rel_seek_secs, int flags)
             stream_seek(s, index->filepos);
             mkv_d->skip_to_timecode = index->timecode * mkv_d->tc_scale;
         } else {
+            // Blocks read from here on leave a hole in the index.
+            mkv_d->index_gap |= !mkv_d->index_complete;
             stream_seek(s, target_filepos);
             if (ebml_resync_cluster(mp_null_log, s) < 0) {
                 // Assume EOF
@@ -2876,6 +3184,7 @@ static void mkv_free(struct demuxer *demuxer)
     struct mkv_demuxer *mkv_d = demuxer->priv;
     if (!mkv_d)
         return;
+    save_index_cache(demuxer);
     mkv_seek_reset(demuxer);
     for (int i = 0; i < mkv_d->num_tracks; i++)
         demux_mkv_free_trackentry(mkv_d->tracks[i]);
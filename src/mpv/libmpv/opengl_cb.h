@@ -195,6 +195,31 @@ int mpv_opengl_cb_init_gl(mpv_opengl_cb_context *ctx, const char *exts,
  */
 int mpv_opengl_cb_render(mpv_opengl_cb_context *ctx, int fbo, int vp[4]);
 
+/**
+ * Statistics of the internal frame queue. Counters are reset when the video
+ * output is (re)created.
+ */
+typedef struct mpv_opengl_cb_frame_stats {
+    /** frames dropped at render time because a newer frame was already due */
+    int64_t dropped_late;
+    /** frames dropped because the queue was full when a frame was queued */
+    int64_t dropped_full;
+    /** current queue depth; varies with "frame-queue-adaptive" */
+    int queue_depth;
+    /** frames waiting to be rendered */
+    int queued_frames;
+    /** average deviation of intervals between render calls in milliseconds */
+    double render_jitter;
+} mpv_opengl_cb_frame_stats;
+
+/**
+ * Retrieve statistics of the frame queue. This can be called from any thread.
+ *
+ * @return error code (same as normal mpv_* API)
+ */
+int mpv_opengl_cb_get_frame_stats(mpv_opengl_cb_context *ctx,
+                                  mpv_opengl_cb_frame_stats *stats);
+
 /**
  * Destroy the mpv OpenGL state.
  *
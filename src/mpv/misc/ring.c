@@ -55,7 +55,7 @@ struct mp_ring *mp_ring_new(void *talloc_ctx, int size)
     return ringbuffer;
 }
 
-int mp_ring_read(struct mp_ring *buffer, unsigned char *dest, int len)
+int mp_ring_peek(struct mp_ring *buffer, unsigned char *dest, int len)
 {
     int size     = mp_ring_size(buffer);
     int buffered = mp_ring_buffered(buffer);
@@ -70,6 +70,13 @@ int mp_ring_read(struct mp_ring *buffer, unsigned char *dest, int len)
         memcpy(dest + len1, buffer->buffer, len2);
     }
 
+    return read_len;
+}
+
+int mp_ring_read(struct mp_ring *buffer, unsigned char *dest, int len)
+{
+    int read_len = mp_ring_peek(buffer, dest, len);
+
     atomic_fetch_add(&buffer->rpos, read_len);
 
     return read_len;
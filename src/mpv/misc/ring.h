@@ -46,6 +46,16 @@ struct mp_ring *mp_ring_new(void *talloc_ctx, int size);
  */
 int mp_ring_read(struct mp_ring *buffer, unsigned char *dest, int len);
 
+/**
+ * Read data from the ringbuffer without consuming it
+ *
+ * buffer: target ringbuffer instance
+ * dest:   destination buffer for the read data
+ * len:    maximum number of bytes to read
+ * return: number of bytes read
+ */
+int mp_ring_peek(struct mp_ring *buffer, unsigned char *dest, int len);
+
 /**
  * Write data to the ringbuffer
  *
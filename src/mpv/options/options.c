@@ -147,6 +147,9 @@ const m_option_t mp_opts[] = {
     OPT_INTRANGE("cache-seek-min", stream_cache.seek_min, 0, 0, 0x7fffffff),
     OPT_STRING("cache-file", stream_cache.file, M_OPT_FILE),
     OPT_INTRANGE("cache-file-size", stream_cache.file_max, 0, 0, 0x7fffffff),
+    OPT_STRING("cache-dir", stream_cache.dir, M_OPT_FILE),
+    OPT_INTRANGE("cache-dir-size", stream_cache.dir_max, 0, 0, 0x7fffffff),
+    OPT_INTRANGE("cache-connections", stream_cache.connections, 0, 1, 16),
 
 #if HAVE_DVDREAD || HAVE_DVDNAV
     OPT_STRING("dvd-device", dvd_device, M_OPT_FILE),
@@ -314,6 +317,9 @@ const m_option_t mp_opts[] = {
     OPT_DOUBLE("demuxer-mkv-subtitle-preroll-secs", mkv_subtitle_preroll_secs,
                M_OPT_MIN, .min = 0),
     OPT_FLAG("demuxer-mkv-probe-video-duration", mkv_probe_duration, 0),
+    OPT_STRING("demuxer-mkv-index-cache-dir", mkv_index_cache_dir, 0),
+    OPT_INTRANGE("demuxer-mkv-index-cache-size", mkv_index_cache_max,
+                 0, 0, 0x7fffffff),
 
 // ------------------------- subtitles options --------------------
 
@@ -726,6 +732,8 @@ const struct MPOpts mp_default_opts = {
         .initial = 0,
         .seek_min = 500,
         .file_max = 1024 * 1024,
+        .dir_max = 4 * 1024 * 1024,
+        .connections = 1,
     },
     .demuxer_thread = 1,
     .demuxer_min_packs = 0,
@@ -782,6 +790,7 @@ const struct MPOpts mp_default_opts = {
     .sub_fix_timing = 1,
     .sub_cp = "auto",
     .mkv_subtitle_preroll_secs = 1.0,
+    .mkv_index_cache_max = 16 * 1024,
     .screenshot_template = "shot%n",
 
     .hwdec_codecs = "h264,vc1,wmv3",
@@ -50,6 +50,9 @@ struct mp_cache_opts {
     int seek_min;
     char *file;
     int file_max;
+    char *dir;
+    int dir_max;
+    int connections;
 };
 
 typedef struct MPOpts {
@@ -206,6 +209,8 @@ typedef struct MPOpts {
     int mkv_subtitle_preroll;
     double mkv_subtitle_preroll_secs;
     int mkv_probe_duration;
+    char *mkv_index_cache_dir;
+    int mkv_index_cache_max;
 
     double demuxer_min_secs_cache;
     int cache_pausing;
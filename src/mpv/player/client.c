@@ -1716,6 +1716,11 @@ int mpv_opengl_cb_uninit_gl(mpv_opengl_cb_context *ctx)
 {
     return MPV_ERROR_NOT_IMPLEMENTED;
 }
+int mpv_opengl_cb_get_frame_stats(mpv_opengl_cb_context *ctx,
+                                  mpv_opengl_cb_frame_stats *stats)
+{
+    return MPV_ERROR_NOT_IMPLEMENTED;
+}
 #endif
 
 void *mpv_get_sub_api(mpv_handle *ctx, mpv_sub_api sub_api)
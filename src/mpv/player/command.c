@@ -1367,6 +1367,31 @@ static int mp_property_cache_idle(void *ctx, struct m_property *prop,
     return m_property_flag_ro(action, arg, !!idle);
 }
 
+static int mp_property_cache_stats(void *ctx, struct m_property *prop,
+                                   int action, void *arg)
+{
+    MPContext *mpctx = ctx;
+    struct stream_cache_stats stats;
+    if (!mpctx->demuxer ||
+        demux_stream_control(mpctx->demuxer, STREAM_CTRL_GET_CACHE_STATS,
+                             &stats) != STREAM_OK)
+        return M_PROPERTY_UNAVAILABLE;
+
+    struct m_sub_property props[] = {
+        {"bytes-in",        SUB_PROP_DOUBLE(stats.bytes_in)},
+        {"bytes-out",       SUB_PROP_DOUBLE(stats.bytes_out)},
+        {"in-rate",         SUB_PROP_DOUBLE(stats.in_rate)},
+        {"out-rate",        SUB_PROP_DOUBLE(stats.out_rate)},
+        {"seeks-cached",    SUB_PROP_INT(stats.seeks_cached)},
+        {"seeks-missed",    SUB_PROP_INT(stats.seeks_missed)},
+        {"underruns",       SUB_PROP_INT(stats.underruns)},
+        {"wait-time",       SUB_PROP_DOUBLE(stats.wait_time)},
+        {0}
+    };
+
+    return m_property_read_sub(props, action, arg);
+}
+
 static int mp_property_demuxer_cache_duration(void *ctx, struct m_property *prop,
                                               int action, void *arg)
 {
@@ -3347,6 +3372,7 @@ static const struct m_property mp_properties[] = {
     {"cache-used", mp_property_cache_used},
     {"cache-size", mp_property_cache_size},
     {"cache-idle", mp_property_cache_idle},
+    {"cache-stats", mp_property_cache_stats},
     {"demuxer-cache-duration", mp_property_demuxer_cache_duration},
     {"demuxer-cache-idle", mp_property_demuxer_cache_idle},
     {"cache-buffering-state", mp_property_cache_buffering},
@@ -3530,7 +3556,8 @@ static const char *const *const mp_event_property_change[] = {
     E(MPV_EVENT_METADATA_UPDATE, "metadata", "filtered-metadata"),
     E(MPV_EVENT_CHAPTER_CHANGE, "chapter", "chapter-metadata"),
     E(MP_EVENT_CACHE_UPDATE, "cache", "cache-free", "cache-used", "cache-idle",
-      "demuxer-cache-duration", "demuxer-cache-idle", "paused-for-cache"),
+      "cache-stats", "demuxer-cache-duration", "demuxer-cache-idle",
+      "paused-for-cache"),
     E(MP_EVENT_WIN_RESIZE, "window-scale"),
     E(MP_EVENT_WIN_STATE, "window-minimized", "display-names"),
     E(MP_EVENT_AUDIO_DEVICES, "audio-device-list"),
@@ -36,6 +36,17 @@
 // Time in seconds the cache prints a new message at all.
 #define CACHE_NO_SPAM 5.0
 
+// Min. time in seconds over which in/out rates of the cache are measured.
+#define CACHE_RATE_TIME 1.0
+
+// Max. number of additional connections for range fetching.
+#define MAX_FETCHERS 16
+
+// Range fetchers read chunks of this size; 2 chunks per fetcher are kept
+// ahead of the cache.
+#define MIN_CHUNK_SIZE (256 * 1024)
+#define MAX_CHUNK_SIZE (4 * 1024 * 1024)
+
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -62,6 +73,34 @@
 #include "stream.h"
 #include "common/common.h"
 
+struct priv;
+
+enum chunk_state {
+    CHUNK_FREE = 0,
+    CHUNK_QUEUED,           // waiting for a fetcher
+    CHUNK_BUSY,             // a fetcher is reading into it
+    CHUNK_DONE,             // fetcher finished; filled < len on error
+};
+
+// A range of the stream which is read ahead of the cache by a fetcher.
+struct range_chunk {
+    enum chunk_state state;
+    bool stale;             // out of window, fetcher should stop
+    int64_t pos;            // file position of data[0]
+    int64_t len;            // requested bytes
+    int64_t filled;         // valid bytes in data
+    unsigned char *data;    // only the fetcher writes beyond filled
+    struct range_fetcher *fetcher;
+};
+
+// Reads chunks through its own connection to the same URL.
+struct range_fetcher {
+    struct priv *s;
+    pthread_t thread;
+    stream_t *stream;       // owned by the fetcher thread
+    struct mp_cancel *cancel;
+};
+
 
 // Note: (struct priv*)(cache->priv)->cache == cache
 struct priv {
@@ -113,6 +152,23 @@ struct priv {
     struct mp_tags *stream_metadata;
     double start_pts;
     bool has_avseek;
+
+    // Statistics; rates are updated when queried
+    struct stream_cache_stats stats;
+    double rate_time;
+    int64_t rate_in, rate_out;
+
+    // Range fetching, enabled if num_fetchers > 0
+    struct range_fetcher *fetchers;
+    int num_fetchers;
+    struct range_chunk *chunks;
+    int num_chunks;
+    int64_t chunk_size;
+    char *fetch_url;
+    struct mpv_global *global;
+    pthread_cond_t fetch_wakeup;    // for fetchers waiting for a job
+    bool fetch_quit;
+    bool fetch_failed;              // fall back to reading s->stream
 };
 
 enum {
@@ -158,7 +214,9 @@ static int cache_wakeup_and_wait(struct priv *s, double *retry_time)
     pthread_cond_signal(&s->wakeup);
     mpthread_cond_timedwait_rel(&s->wakeup, &s->mutex, CACHE_WAIT_TIME);
 
-    *retry_time += mp_time_sec() - start;
+    double waited = mp_time_sec() - start;
+    *retry_time += waited;
+    s->stats.wait_time += waited;
 
     return 0;
 }
@@ -205,6 +263,156 @@ static size_t read_buffer(struct priv *s, unsigned char *dst,
     return read;
 }
 
+static void *fetcher_thread(void *arg)
+{
+    struct range_fetcher *f = arg;
+    struct priv *s = f->s;
+    mpthread_set_name("cache fetch");
+    pthread_mutex_lock(&s->mutex);
+    while (!s->fetch_quit) {
+        // closest to the read position first
+        struct range_chunk *c = NULL;
+        for (int n = 0; n < s->num_chunks; n++) {
+            struct range_chunk *cur = &s->chunks[n];
+            if (cur->state == CHUNK_QUEUED && (!c || cur->pos < c->pos))
+                c = cur;
+        }
+        if (!c || s->fetch_failed) {
+            pthread_cond_wait(&s->fetch_wakeup, &s->mutex);
+            continue;
+        }
+        c->state = CHUNK_BUSY;
+        c->fetcher = f;
+        mp_cancel_reset(f->cancel);
+        pthread_mutex_unlock(&s->mutex);
+
+        if (!f->stream) {
+            f->stream = stream_create(s->fetch_url,
+                                      STREAM_READ | STREAM_NETWORK_ONLY,
+                                      f->cancel, s->global);
+        }
+        bool ok = f->stream && f->stream->seekable &&
+                  stream_seek(f->stream, c->pos) &&
+                  stream_tell(f->stream) == c->pos;
+        // Reconnecting doesn't help if the connection can't be positioned at
+        // all, e.g. with a server which ignores Range requests.
+        bool unusable = !ok;
+        while (ok) {
+            pthread_mutex_lock(&s->mutex);
+            bool stop = c->stale || c->filled >= c->len;
+            int64_t filled = c->filled;
+            pthread_mutex_unlock(&s->mutex);
+            if (stop)
+                break;
+            int want = MPMIN(c->len - filled, f->stream->read_chunk);
+            int r = stream_read_partial(f->stream, c->data + filled, want);
+            pthread_mutex_lock(&s->mutex);
+            if (r > 0)
+                c->filled += r;
+            pthread_cond_broadcast(&s->wakeup);
+            pthread_mutex_unlock(&s->mutex);
+            ok = r > 0;
+        }
+
+        pthread_mutex_lock(&s->mutex);
+        if (unusable && !c->stale) {
+            MP_WARN(s, "Range fetching failed, using a single connection.\n");
+            s->fetch_failed = true;
+        }
+        // the connection is in an undefined state after cancellation
+        if (!ok || c->stale) {
+            pthread_mutex_unlock(&s->mutex);
+            free_stream(f->stream);
+            f->stream = NULL;
+            pthread_mutex_lock(&s->mutex);
+        }
+        c->state = c->stale ? CHUNK_FREE : CHUNK_DONE;
+        c->stale = false;
+        c->fetcher = NULL;
+        pthread_cond_broadcast(&s->wakeup);
+    }
+    pthread_mutex_unlock(&s->mutex);
+    return NULL;
+}
+
+static void chunk_drop(struct range_chunk *c)
+{
+    if (c->state == CHUNK_BUSY) {
+        if (!c->stale) {
+            c->stale = true;
+            mp_cancel_trigger(c->fetcher->cancel);
+        }
+    } else {
+        c->state = CHUNK_FREE;
+    }
+}
+
+// Make chunks cover the window ahead of pos, dropping chunks outside of it.
+// This is what re-prioritizes fetching after seeks.
+// Runs in the cache thread, with the mutex held.
+static void fetch_schedule(struct priv *s, int64_t pos, int64_t limit)
+{
+    int64_t start = pos - pos % s->chunk_size;
+    int64_t end = MPMIN(start + s->num_chunks * s->chunk_size, limit);
+    for (int n = 0; n < s->num_chunks; n++) {
+        struct range_chunk *c = &s->chunks[n];
+        if (c->state != CHUNK_FREE && !c->stale &&
+            (c->pos + c->len <= pos || c->pos >= end))
+            chunk_drop(c);
+    }
+    bool queued = false;
+    for (int64_t cpos = start; cpos < end; cpos += s->chunk_size) {
+        struct range_chunk *free_chunk = NULL;
+        bool found = false;
+        for (int n = 0; n < s->num_chunks; n++) {
+            struct range_chunk *c = &s->chunks[n];
+            if (c->state == CHUNK_FREE) {
+                free_chunk = free_chunk ? free_chunk : c;
+            } else if (!c->stale && c->pos == cpos) {
+                found = true;
+            }
+        }
+        if (found)
+            continue;
+        if (!free_chunk)
+            break;
+        *free_chunk = (struct range_chunk){
+            .state = CHUNK_QUEUED,
+            .pos = cpos,
+            .len = MPMIN(s->chunk_size, s->stream_size - cpos),
+            .data = free_chunk->data,
+        };
+        queued = true;
+    }
+    if (queued)
+        pthread_cond_broadcast(&s->fetch_wakeup);
+}
+
+// Copy fetched data at max_filepos to dst.
+// Returns number of bytes copied, 0 if data is not there yet, or -1 if the
+// data has to be read from s->stream instead.
+// Runs in the cache thread, with the mutex held.
+static int fetch_read(struct priv *s, unsigned char *dst, int64_t dst_size)
+{
+    int64_t pos = s->max_filepos;
+    if (s->fetch_failed || s->stream_size <= 0 || pos >= s->stream_size)
+        return -1;
+    fetch_schedule(s, pos, s->stream_size);
+    for (int n = 0; n < s->num_chunks; n++) {
+        struct range_chunk *c = &s->chunks[n];
+        if (c->state == CHUNK_FREE || c->stale ||
+            pos < c->pos || pos >= c->pos + c->len)
+            continue;
+        int64_t avail = c->pos + c->filled - pos;
+        if (avail <= 0)
+            return c->state == CHUNK_DONE ? -1 : 0;
+        int64_t len = MPMIN(avail, dst_size);
+        memcpy(dst, c->data + (pos - c->pos), len);
+        return len;
+    }
+    return 0;
+}
+
 // Runs in the cache thread.
 // Returns true if reading was attempted, and the mutex was shortly unlocked.
 static bool cache_fill(struct priv *s)
@@ -223,14 +431,6 @@ static bool cache_fill(struct priv *s)
         cache_drop_contents(s);
     }
 
-    if (stream_tell(s->stream) != s->max_filepos && s->seekable) {
-        MP_VERBOSE(s, "Seeking underlying stream: %"PRId64" -> %"PRId64"\n",
-                   stream_tell(s->stream), s->max_filepos);
-        stream_seek(s->stream, s->max_filepos);
-        if (stream_tell(s->stream) != s->max_filepos)
-            goto done;
-    }
-
     // number of buffer bytes which should be preserved in backwards direction
     int64_t back = mp_clipi64(read - s->min_filepos, 0, s->back_size);
 
@@ -263,6 +463,26 @@ static bool cache_fill(struct priv *s)
     if (s->min_filepos < (read - back2))
         s->min_filepos = read - back2;
 
+    if (s->num_fetchers > 0) {
+        len = fetch_read(s, &s->buffer[pos], space);
+        if (len == 0) {
+            // wait for fetchers; they wake us up on new data
+            mpthread_cond_timedwait_rel(&s->wakeup, &s->mutex, CACHE_WAIT_TIME);
+            return true;
+        }
+        if (len > 0)
+            goto read_done;
+        len = 0;
+    }
+
+    if (stream_tell(s->stream) != s->max_filepos && s->seekable) {
+        MP_VERBOSE(s, "Seeking underlying stream: %"PRId64" -> %"PRId64"\n",
+                   stream_tell(s->stream), s->max_filepos);
+        stream_seek(s->stream, s->max_filepos);
+        if (stream_tell(s->stream) != s->max_filepos)
+            goto done;
+    }
+
     // The read call might take a long time and block, so drop the lock.
     pthread_mutex_unlock(&s->mutex);
     len = stream_read_partial(s->stream, &s->buffer[pos], space);
@@ -276,7 +496,10 @@ static bool cache_fill(struct priv *s)
             s->start_pts = pts;
     }
 
+read_done:
     s->max_filepos += len;
+    if (len > 0)
+        s->stats.bytes_in += len;
     if (pos + len == s->buffer_size)
         s->offset += s->buffer_size; // wrap...
 
@@ -404,6 +627,21 @@ static int cache_get_cached_control(stream_t *cache, int cmd, void *arg)
         }
         return STREAM_UNSUPPORTED;
     }
+    case STREAM_CTRL_GET_CACHE_STATS: {
+        double now = mp_time_sec();
+        if (now - s->rate_time >= CACHE_RATE_TIME) {
+            if (s->rate_time > 0) {
+                double t = now - s->rate_time;
+                s->stats.in_rate = (s->stats.bytes_in - s->rate_in) / t;
+                s->stats.out_rate = (s->stats.bytes_out - s->rate_out) / t;
+            }
+            s->rate_time = now;
+            s->rate_in = s->stats.bytes_in;
+            s->rate_out = s->stats.bytes_out;
+        }
+        *(struct stream_cache_stats *)arg = s->stats;
+        return STREAM_OK;
+    }
     case STREAM_CTRL_RESUME_CACHE:
         s->idle = s->eof = false;
         pthread_cond_signal(&s->wakeup);
@@ -505,14 +743,19 @@ static int cache_fill_buffer(struct stream *cache, char *buffer, int max_len)
     int readb = 0;
     if (max_len > 0) {
         double retry_time = 0;
+        bool underrun = false;
         int64_t retry = s->reads - 1; // try at least 1 read on EOF
         while (1) {
             readb = read_buffer(s, buffer, max_len, s->read_filepos);
             s->read_filepos += readb;
+            s->stats.bytes_out += readb;
             if (readb > 0)
                 break;
             if (s->eof && s->read_filepos >= s->max_filepos && s->reads >= retry)
                 break;
+            if (!underrun)
+                s->stats.underruns++;
+            underrun = true;
             s->idle = false;
             if (cache_wakeup_and_wait(s, &retry_time) == CACHE_INTERRUPTED)
                 break;
@@ -544,6 +787,11 @@ static int cache_seek(stream_t *cache, int64_t pos)
         MP_ERR(s, "Attempting to seek before cached data in unseekable stream.\n");
         r = 0;
     } else {
+        if (pos >= s->min_filepos && pos <= s->max_filepos) {
+            s->stats.seeks_cached++;
+        } else {
+            s->stats.seeks_missed++;
+        }
         cache->pos = s->read_filepos = pos;
         s->eof = false; // so that cache_read() will actually wait for new data
         pthread_cond_signal(&s->wakeup);
@@ -590,6 +838,61 @@ done:
     return r;
 }
 
+// Start fetchers if the stream can be opened again at any position.
+static void fetch_init(struct priv *s, stream_t *cache, stream_t *stream,
+                       int connections)
+{
+    int64_t size = -1;
+    if (!stream->is_network || !stream->seekable || stream->uncached_stream ||
+        stream_control(stream, STREAM_CTRL_GET_SIZE, &size) != STREAM_OK ||
+        size <= 0)
+    {
+        MP_VERBOSE(s, "Range fetching is not possible for this stream.\n");
+        return;
+    }
+
+    pthread_cond_init(&s->fetch_wakeup, NULL);
+    s->fetch_url = talloc_strdup(s, stream->url);
+    s->global = cache->global;
+    s->num_chunks = MPMIN(connections, MAX_FETCHERS) * 2;
+    s->chunk_size = mp_clipi64(s->buffer_size / (2 * s->num_chunks),
+                               MIN_CHUNK_SIZE, MAX_CHUNK_SIZE);
+    s->chunks = talloc_zero_array(s, struct range_chunk, s->num_chunks);
+    for (int n = 0; n < s->num_chunks; n++)
+        s->chunks[n].data = talloc_size(s, s->chunk_size);
+
+    s->fetchers = talloc_zero_array(s, struct range_fetcher, s->num_chunks / 2);
+    for (int n = 0; n < s->num_chunks / 2; n++) {
+        struct range_fetcher *f = &s->fetchers[n];
+        f->s = s;
+        f->cancel = mp_cancel_new(s);
+        if (pthread_create(&f->thread, NULL, fetcher_thread, f) != 0) {
+            MP_ERR(s, "Starting fetcher thread failed.\n");
+            break;
+        }
+        s->num_fetchers++;
+    }
+    MP_VERBOSE(s, "Fetching %d KiB ranges with %d connections.\n",
+               (int)(s->chunk_size / 1024), s->num_fetchers);
+}
+
+static void fetch_uninit(struct priv *s)
+{
+    if (!s->fetch_url)
+        return;
+    pthread_mutex_lock(&s->mutex);
+    s->fetch_quit = true;
+    for (int n = 0; n < s->num_fetchers; n++)
+        mp_cancel_trigger(s->fetchers[n].cancel);
+    pthread_cond_broadcast(&s->fetch_wakeup);
+    pthread_mutex_unlock(&s->mutex);
+    for (int n = 0; n < s->num_fetchers; n++) {
+        pthread_join(s->fetchers[n].thread, NULL);
+        free_stream(s->fetchers[n].stream);
+    }
+    pthread_cond_destroy(&s->fetch_wakeup);
+}
+
 static void cache_uninit(stream_t *cache)
 {
     struct priv *s = cache->priv;
@@ -601,6 +904,7 @@ static void cache_uninit(stream_t *cache)
         pthread_mutex_unlock(&s->mutex);
         pthread_join(s->cache_thread, NULL);
     }
+    fetch_uninit(s);
     pthread_mutex_destroy(&s->mutex);
     pthread_cond_destroy(&s->wakeup);
     free(s->buffer);
@@ -649,6 +953,9 @@ int stream_cache_init(stream_t *cache, stream_t *stream,
 
     s->seekable = stream->seekable;
 
+    if (opts->connections > 1)
+        fetch_init(s, cache, stream, opts->connections);
+
     if (pthread_create(&s->cache_thread, NULL, cache_thread, s) != 0) {
         MP_ERR(s, "Starting cache thread failed.\n");
         return -1;
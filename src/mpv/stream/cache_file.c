@@ -16,6 +16,11 @@
  */
 #include <stdio.h>
 #include <stdint.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <dirent.h>
 
 #include "osdep/io.h"
 
@@ -23,11 +28,30 @@
 #include "common/msg.h"
 
 #include "options/options.h"
+#include "options/path.h"
 
 #include "stream.h"
 
 #define BLOCK_SIZE 1024LL
 #define BLOCK_ALIGN(p) ((p) & ~(BLOCK_SIZE - 1))
+// max. number of missing blocks fetched from the source at once
+#define FETCH_BLOCKS 64
+
+#define INDEX_MAGIC "mpvcache"
+#define INDEX_VERSION 1
+
+// Index file of the persistent cache. The header is followed by the URL and
+// block_bits, and the whole file is mapped into memory while the stream is
+// open, so that block_bits survive the player.
+struct index_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t block_size;
+    int64_t size;           // size of the source stream
+    int64_t used;           // bytes in valid blocks at last clean close
+    uint32_t url_len;
+    uint32_t bits_len;
+};
 
 struct priv {
     struct stream *original;
@@ -35,8 +59,21 @@ struct priv {
     uint8_t *block_bits;    // 1 bit for each BLOCK_SIZE, whether block was read
     int64_t size;           // currently known size
     int64_t max_size;       // max. size for block_bits and cache_file
+
+    // persistent cache only
+    char *dir;
+    char *name;             // file name in dir without extension
+    int64_t dir_max;
+    struct index_header *index;
+    size_t index_size;
+    int index_fd;
 };
 
+static size_t bits_len(int64_t max_size)
+{
+    return (max_size / BLOCK_SIZE + 1) / 8 + 1;
+}
+
 static bool test_bit(struct priv *p, int64_t pos)
 {
     if (pos < 0 || pos >= p->size)
@@ -74,10 +111,16 @@ static int fill_buffer(stream_t *s, char *buffer, int max_len)
     }
     int64_t aligned = BLOCK_ALIGN(s->pos);
     if (!test_bit(p, aligned)) {
-        char tmp[BLOCK_SIZE];
+        // fetch following missing blocks too, to avoid a request per block
+        int blocks = 1;
+        while (blocks < FETCH_BLOCKS && aligned + blocks * BLOCK_SIZE < p->size
+               && !test_bit(p, aligned + blocks * BLOCK_SIZE))
+            blocks++;
+        char tmp[FETCH_BLOCKS * BLOCK_SIZE];
+        int want = blocks * BLOCK_SIZE;
         stream_seek(p->original, aligned);
-        int r = stream_read(p->original, tmp, BLOCK_SIZE);
-        if (r < BLOCK_SIZE) {
+        int r = stream_read(p->original, tmp, want);
+        if (r < want) {
             if (p->size < 0) {
                 MP_WARN(s, "suspected EOF\n");
             } else if (aligned + r < p->size) {
@@ -85,11 +128,21 @@ static int fill_buffer(stream_t *s, char *buffer, int max_len)
                 return -1;
             }
         }
+        if (r <= 0)
+            return -1;
         if (fseeko(p->cache_file, aligned, SEEK_SET))
             return -1;
         if (fwrite(tmp, r, 1, p->cache_file) != 1)
             return -1;
-        set_bit(p, aligned, 1);
+        // block_bits is shared with the index file: a block must not be
+        // marked valid while its data still sits in the stdio buffer
+        if (fflush(p->cache_file))
+            return -1;
+        // a partial block is valid only at the end of the stream
+        for (int64_t pos = aligned; pos < aligned + r; pos += BLOCK_SIZE) {
+            if (pos + BLOCK_SIZE <= aligned + r || aligned + r >= p->size)
+                set_bit(p, pos, 1);
+        }
     }
     if (fseeko(p->cache_file, s->pos, SEEK_SET))
         return -1;
@@ -112,11 +165,237 @@ static int control(stream_t *s, int cmd, void *arg)
     return stream_control(p->original, cmd, arg);
 }
 
+static int64_t count_used(const uint8_t *block_bits, size_t len)
+{
+    int64_t blocks = 0;
+    for (size_t n = 0; n < len; n++) {
+        for (unsigned int b = block_bits[n]; b; b &= b - 1)
+            blocks++;
+    }
+    return blocks * BLOCK_SIZE;
+}
+
+// Bytes in valid blocks of the stream whose index file is at path. The used
+// field of the header is stale after a crash, so count block_bits instead.
+// If the index is broken, the size of the data file is taken.
+static int64_t stored_size(void *ta_ctx, const char *path, int64_t index_size,
+                           const char *data_path)
+{
+    int64_t used = -1;
+    FILE *f = fopen(path, "rb");
+    if (f) {
+        struct index_header h;
+        if (fread(&h, sizeof(h), 1, f) == 1 &&
+            memcmp(h.magic, INDEX_MAGIC, sizeof(h.magic)) == 0)
+        {
+            int64_t offset = MP_ALIGN_UP(sizeof(h) + h.url_len, 8);
+            if (offset + h.bits_len <= index_size &&
+                fseeko(f, offset, SEEK_SET) == 0)
+            {
+                uint8_t *bits = talloc_size(ta_ctx, h.bits_len);
+                if (fread(bits, h.bits_len, 1, f) == 1)
+                    used = count_used(bits, h.bits_len);
+                talloc_free(bits);
+            }
+        }
+        fclose(f);
+    }
+    struct stat st;
+    if (used < 0)
+        used = stat(data_path, &st) == 0 ? st.st_size : 0;
+    return used;
+}
+
+static char *cache_path(void *ta_ctx, const char *dir, const char *name,
+                        const char *ext)
+{
+    char *file = talloc_asprintf(ta_ctx, "%s%s", name, ext);
+    return mp_path_join(ta_ctx, bstr0(dir), bstr0(file));
+}
+
+struct cache_entry {
+    char *name;
+    time_t mtime;
+    int64_t used;
+};
+
+static int cmp_mtime(const void *a, const void *b)
+{
+    const struct cache_entry *e1 = a, *e2 = b;
+    return e1->mtime < e2->mtime ? -1 : (e1->mtime > e2->mtime ? 1 : 0);
+}
+
+// Remove least recently used streams until the total fits into budget.
+// The stream called keep is left alone even if it's the oldest.
+static void evict(struct mp_log *log, const char *dir, int64_t budget,
+                  const char *keep)
+{
+    DIR *d = opendir(dir);
+    if (!d)
+        return;
+    void *tmp = talloc_new(NULL);
+    struct cache_entry *entries = NULL;
+    int num_entries = 0;
+    int64_t total = 0;
+    struct dirent *de;
+    while ((de = readdir(d))) {
+        bstr name = bstr0(de->d_name);
+        if (!bstr_endswith0(name, ".idx"))
+            continue;
+        char *path = mp_path_join(tmp, bstr0(dir), name);
+        struct stat st;
+        if (stat(path, &st) != 0)
+            continue;
+        struct cache_entry e = {
+            .name = bstrto0(tmp, bstr_splice(name, 0, -4)),
+            .mtime = st.st_mtime,
+        };
+        e.used = stored_size(tmp, path, st.st_size,
+                             cache_path(tmp, dir, e.name, ".data"));
+        MP_TARRAY_APPEND(tmp, entries, num_entries, e);
+        total += e.used;
+    }
+    closedir(d);
+    qsort(entries, num_entries, sizeof(entries[0]), cmp_mtime);
+    for (int n = 0; n < num_entries && total > budget; n++) {
+        if (keep && strcmp(entries[n].name, keep) == 0)
+            continue;
+        unlink(cache_path(tmp, dir, entries[n].name, ".data"));
+        unlink(cache_path(tmp, dir, entries[n].name, ".idx"));
+        total -= entries[n].used;
+        mp_verbose(log, "removed %s from persistent cache\n", entries[n].name);
+    }
+    talloc_free(tmp);
+}
+
+static uint64_t hash_url(const char *url)
+{
+    // FNV-1a
+    uint64_t h = 14695981039346656037ULL;
+    for (const char *c = url; *c; c++)
+        h = (h ^ (uint8_t)*c) * 1099511628211ULL;
+    return h;
+}
+
+static bool map_index(struct priv *p)
+{
+    void *m = mmap(NULL, p->index_size, PROT_READ | PROT_WRITE, MAP_SHARED,
+                   p->index_fd, 0);
+    if (m == MAP_FAILED)
+        return false;
+    p->index = m;
+    return true;
+}
+
+// Open data and index file in dir for the stream. Blocks cached in previous
+// sessions are reused if the index was written for the same URL and size.
+static bool open_persistent(stream_t *cache, struct priv *p, stream_t *stream,
+                            struct mp_cache_opts *opts)
+{
+    int64_t size = -1;
+    if (stream_control(stream, STREAM_CTRL_GET_SIZE, &size) != STREAM_OK ||
+        size <= 0)
+    {
+        MP_WARN(cache, "unknown stream size, not using persistent cache\n");
+        return false;
+    }
+
+    p->dir = mp_get_user_path(p, cache->global, opts->dir);
+    mp_mkdirp(p->dir);
+    p->dir_max = opts->dir_max * 1024LL;
+    p->max_size = MPMIN(MPMIN(p->max_size, p->dir_max), size);
+
+    const char *url = stream->url ? stream->url : "";
+    size_t url_len = strlen(url);
+    size_t header_size = MP_ALIGN_UP(sizeof(struct index_header) + url_len, 8);
+    size_t bits = bits_len(p->max_size);
+    p->name = talloc_asprintf(p, "%016" PRIx64, hash_url(url));
+    p->index_size = header_size + bits;
+
+    evict(cache->log, p->dir, p->dir_max, p->name);
+
+    char *index_path = cache_path(p, p->dir, p->name, ".idx");
+    char *data_path = cache_path(p, p->dir, p->name, ".data");
+
+    p->index_fd = open(index_path, O_RDWR | O_CREAT | O_BINARY, 0644);
+    if (p->index_fd < 0) {
+        MP_ERR(cache, "can't open cache index '%s'\n", index_path);
+        return false;
+    }
+    struct stat st;
+    bool valid = fstat(p->index_fd, &st) == 0 && st.st_size == p->index_size
+                 && map_index(p);
+    if (valid) {
+        struct index_header *h = p->index;
+        valid = memcmp(h->magic, INDEX_MAGIC, sizeof(h->magic)) == 0 &&
+                h->version == INDEX_VERSION && h->block_size == BLOCK_SIZE &&
+                h->size == size && h->url_len == url_len &&
+                h->bits_len == bits &&
+                memcmp((char *)h + sizeof(*h), url, url_len) == 0;
+    }
+    if (valid)
+        p->cache_file = fopen(data_path, "rb+");
+    if (!p->cache_file) {
+        // stale or missing: start over with empty files
+        if (p->index)
+            munmap(p->index, p->index_size);
+        p->index = NULL;
+        close(p->index_fd);
+        p->index_fd = open(index_path, O_RDWR | O_CREAT | O_TRUNC | O_BINARY,
+                           0644);
+        char zero = 0;
+        if (p->index_fd < 0 ||
+            lseek(p->index_fd, p->index_size - 1, SEEK_SET) < 0 ||
+            write(p->index_fd, &zero, 1) != 1 || !map_index(p))
+        {
+            MP_ERR(cache, "can't create cache index '%s'\n", index_path);
+            return false;
+        }
+        struct index_header *h = p->index;
+        memcpy(h->magic, INDEX_MAGIC, sizeof(h->magic));
+        h->version = INDEX_VERSION;
+        h->block_size = BLOCK_SIZE;
+        h->size = size;
+        h->url_len = url_len;
+        h->bits_len = bits;
+        memcpy((char *)h + sizeof(*h), url, url_len);
+        p->cache_file = fopen(data_path, "wb+");
+        if (!p->cache_file) {
+            MP_ERR(cache, "can't open cache file '%s'\n", data_path);
+            return false;
+        }
+    } else {
+        MP_VERBOSE(cache, "reusing persistent cache %s\n", p->name);
+    }
+    p->block_bits = (uint8_t *)p->index + header_size;
+    return true;
+}
+
+static void close_persistent(stream_t *s, struct priv *p)
+{
+    if (p->index) {
+        struct index_header h = *p->index;
+        h.used = p->block_bits ? count_used(p->block_bits, h.bits_len) : 0;
+        munmap(p->index, p->index_size);
+        p->index = NULL;
+        // written through the fd to update mtime used for eviction order
+        if (lseek(p->index_fd, 0, SEEK_SET) != 0 ||
+            write(p->index_fd, &h, sizeof(h)) != sizeof(h))
+            MP_WARN(s, "can't update cache index %s\n", p->name);
+    }
+    if (p->index_fd >= 0)
+        close(p->index_fd);
+    p->index_fd = -1;
+    if (p->dir)
+        evict(s->log, p->dir, p->dir_max, p->name);
+}
+
 static void s_close(stream_t *s)
 {
     struct priv *p = s->priv;
     if (p->cache_file)
         fclose(p->cache_file);
+    close_persistent(s, p);
     talloc_free(p);
 }
 
@@ -124,7 +403,9 @@ static void s_close(stream_t *s)
 int stream_file_cache_init(stream_t *cache, stream_t *stream,
                            struct mp_cache_opts *opts)
 {
-    if (!opts->file || !opts->file[0] || opts->file_max < 1)
+    bool persistent = opts->dir && opts->dir[0] && opts->dir_max > 0;
+    bool temporary = opts->file && opts->file[0];
+    if ((!persistent && !temporary) || opts->file_max < 1)
         return 0;
 
     if (!stream->seekable) {
@@ -132,23 +413,37 @@ int stream_file_cache_init(stream_t *cache, stream_t *stream,
         return -1;
     }
 
-    bool use_anon_file = strcmp(opts->file, "TMP") == 0;
-    FILE *file = use_anon_file ? tmpfile() : fopen(opts->file, "wb+");
-    if (!file) {
-        MP_ERR(cache, "can't open cache file '%s'\n", opts->file);
-        return -1;
-    }
-
     struct priv *p = talloc_zero(NULL, struct priv);
-
-    cache->priv = p;
     p->original = stream;
-    p->cache_file = file;
+    p->index_fd = -1;
     p->max_size = opts->file_max * 1024LL;
 
-    // file_max can be INT_MAX, so this is at most about 256MB
-    p->block_bits = talloc_zero_size(p, (p->max_size / BLOCK_SIZE + 1) / 8 + 1);
+    if (persistent && !open_persistent(cache, p, stream, opts)) {
+        if (p->cache_file)
+            fclose(p->cache_file);
+        p->cache_file = NULL;
+        close_persistent(cache, p);
+        p->dir = NULL;
+        p->max_size = opts->file_max * 1024LL;
+        if (!temporary) {
+            talloc_free(p);
+            return 0;
+        }
+    }
 
+    if (!p->cache_file) {
+        bool use_anon_file = strcmp(opts->file, "TMP") == 0;
+        p->cache_file = use_anon_file ? tmpfile() : fopen(opts->file, "wb+");
+        if (!p->cache_file) {
+            MP_ERR(cache, "can't open cache file '%s'\n", opts->file);
+            talloc_free(p);
+            return -1;
+        }
+        // file_max can be INT_MAX, so this is at most about 256MB
+        p->block_bits = talloc_zero_size(p, bits_len(p->max_size));
+    }
+
+    cache->priv = p;
     cache->seek = seek;
     cache->fill_buffer = fill_buffer;
     cache->control = control;
@@ -73,6 +73,7 @@ enum stream_ctrl {
     STREAM_CTRL_GET_CACHE_FILL,
     STREAM_CTRL_GET_CACHE_IDLE,
     STREAM_CTRL_RESUME_CACHE,
+    STREAM_CTRL_GET_CACHE_STATS,
 
     // stream_memory.c
     STREAM_CTRL_SET_CONTENTS,
@@ -146,6 +147,18 @@ struct stream_avseek {
     int flags;
 };
 
+// for STREAM_CTRL_GET_CACHE_STATS
+struct stream_cache_stats {
+    int64_t bytes_in;       // read from the source
+    int64_t bytes_out;      // consumed by the reader
+    double in_rate;         // bytes/s, over the last second or so
+    double out_rate;
+    int64_t seeks_cached;   // seeks to a position inside the cached range
+    int64_t seeks_missed;   // seeks which had to refetch from the source
+    int64_t underruns;      // reads which had to wait for the cache
+    double wait_time;       // seconds spent waiting for the cache thread
+};
+
 struct stream;
 typedef struct stream_info_st {
     const char *name;
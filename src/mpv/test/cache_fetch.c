@@ -0,0 +1,103 @@
+#include "test_helpers.h"
+#include "http_server.h"
+
+#include "common/global.h"
+#include "common/msg.h"
+#include "common/msg_control.h"
+#include "common/av_log.h"
+#include "options/m_config.h"
+#include "options/options.h"
+#include "stream/stream.h"
+#include "talloc.h"
+
+#define FILE_SIZE (8 * 1024 * 1024)
+#define CONNECTIONS 4
+
+static unsigned char file_data[FILE_SIZE];
+static struct http_server server;
+
+struct fixture {
+    struct mpv_global *global;
+    struct mp_cancel *cancel;
+    stream_t *stream;
+};
+
+static struct fixture *fixture_new(enum http_range_mode mode)
+{
+    for (int n = 0; n < FILE_SIZE; n++)
+        file_data[n] = (n * 2654435761u) >> 24;
+    assert_true(http_server_start(&server, file_data, FILE_SIZE, mode));
+
+    struct fixture *fx = talloc_zero(NULL, struct fixture);
+    fx->global = talloc_zero(fx, struct mpv_global);
+    mp_msg_init(fx->global);
+    struct mp_log *log = mp_log_new(fx, fx->global->log, "test");
+    struct m_config *config = m_config_new(fx, log, sizeof(struct MPOpts),
+                                           &mp_default_opts, mp_opts);
+    fx->global->opts = config->optstruct;
+    init_libav(fx->global);
+    fx->cancel = mp_cancel_new(fx);
+
+    char *url = talloc_asprintf(fx, "http://127.0.0.1:%d/file", server.port);
+    fx->stream = stream_create(url, STREAM_READ | STREAM_NETWORK_ONLY,
+                               fx->cancel, fx->global);
+    assert_non_null(fx->stream);
+    struct mp_cache_opts opts = {
+        .size = FILE_SIZE / 1024 / 4,   // KiB; a quarter of the file
+        .seek_min = 0,
+        .connections = CONNECTIONS,
+    };
+    assert_int_equal(stream_enable_cache(&fx->stream, &opts), 1);
+    return fx;
+}
+
+static void fixture_free(struct fixture *fx)
+{
+    free_stream(fx->stream);
+    http_server_stop(&server);
+    uninit_libav(fx->global);
+    mp_msg_uninit(fx->global);
+    talloc_free(fx);
+}
+
+static void assert_read(stream_t *s, int64_t pos, int64_t len)
+{
+    static char buf[FILE_SIZE];
+    assert_true(stream_seek(s, pos));
+    assert_int_equal(stream_read(s, buf, len), len);
+    assert_memory_equal(buf, file_data + pos, len);
+}
+
+static void test_fetch_ranges(void **state) {
+    struct fixture *fx = fixture_new(HTTP_RANGES);
+    assert_read(fx->stream, 0, FILE_SIZE);
+    // fetchers move to the new position after seeking back
+    assert_read(fx->stream, FILE_SIZE / 3, FILE_SIZE / 3);
+    assert_read(fx->stream, 1000, 64 * 1024);
+    pthread_mutex_lock(&server.lock);
+    int ranged = server.requests_ranged;
+    pthread_mutex_unlock(&server.lock);
+    // range requests of fetchers, not only seeks of one connection
+    assert_true(ranged > CONNECTIONS);
+    fixture_free(fx);
+}
+
+static void test_fetch_not_seekable_falls_back(void **state) {
+    struct fixture *fx = fixture_new(HTTP_RANGES_NOT_AT_0);
+    assert_read(fx->stream, 0, FILE_SIZE);
+    pthread_mutex_lock(&server.lock);
+    int at_0 = server.requests_at_0;
+    pthread_mutex_unlock(&server.lock);
+    // the first request of the stream plus at most one failed connection per
+    // fetcher; reconnecting for every chunk would take far more
+    assert_true(at_0 <= 1 + CONNECTIONS);
+    fixture_free(fx);
+}
+
+int main(void) {
+    const UnitTest tests[] = {
+        unit_test(test_fetch_ranges),
+        unit_test(test_fetch_not_seekable_falls_back),
+    };
+    return run_tests(tests);
+}
@@ -0,0 +1,198 @@
+#ifndef MP_TEST_HTTP_SERVER_H
+#define MP_TEST_HTTP_SERVER_H
+
+// Minimal HTTP/1.1 server on 127.0.0.1 for stream tests. It serves one
+// in-memory file at any path, one request per connection, each connection
+// in its own thread.
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+enum http_range_mode {
+    HTTP_RANGES,            // honor Range with 206 and advertise it
+    HTTP_RANGES_NOT_AT_0,   // like HTTP_RANGES, except for requests after
+                            // the first which start at 0: those get a plain
+                            // 200 without Accept-Ranges, so a reopened
+                            // connection is not seekable
+};
+
+struct http_server {
+    const unsigned char *data;
+    int64_t size;
+    enum http_range_mode mode;
+    int port;
+    int fd;
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t idle;
+    int connections;        // connection threads running
+    int requests;           // all requests
+    int requests_at_0;      // requests without Range or starting at 0
+    int requests_ranged;    // requests starting after 0
+};
+
+struct http_conn {
+    struct http_server *server;
+    int fd;
+};
+
+static bool http_send(int fd, const void *buf, size_t len)
+{
+    const char *p = buf;
+    while (len > 0) {
+        ssize_t r = send(fd, p, len, MSG_NOSIGNAL);
+        if (r <= 0)
+            return false;
+        p += r;
+        len -= r;
+    }
+    return true;
+}
+
+static void *http_conn_thread(void *arg)
+{
+    struct http_conn *conn = arg;
+    struct http_server *srv = conn->server;
+    char req[4096];
+    size_t len = 0;
+    while (len < sizeof(req) - 1) {
+        ssize_t r = recv(conn->fd, req + len, sizeof(req) - 1 - len, 0);
+        if (r <= 0)
+            goto done;
+        len += r;
+        req[len] = '\0';
+        if (strstr(req, "\r\n\r\n"))
+            break;
+    }
+
+    int64_t start = 0;
+    const char *range = strcasestr(req, "\r\nRange: bytes=");
+    if (range)
+        start = strtoll(range + strlen("\r\nRange: bytes="), NULL, 10);
+
+    pthread_mutex_lock(&srv->lock);
+    bool first = srv->requests++ == 0;
+    if (start > 0) {
+        srv->requests_ranged++;
+    } else {
+        srv->requests_at_0++;
+    }
+    pthread_mutex_unlock(&srv->lock);
+
+    bool ranged = srv->mode == HTTP_RANGES || first || start > 0;
+    if (start >= srv->size) {
+        const char *head = "HTTP/1.1 416 Requested Range Not Satisfiable\r\n"
+                           "Content-Length: 0\r\nConnection: close\r\n\r\n";
+        http_send(conn->fd, head, strlen(head));
+        goto done;
+    }
+    if (!ranged)
+        start = 0;
+    char head[512];
+    if (ranged) {
+        snprintf(head, sizeof(head),
+                 "HTTP/1.1 206 Partial Content\r\n"
+                 "Accept-Ranges: bytes\r\n"
+                 "Content-Range: bytes %"PRId64"-%"PRId64"/%"PRId64"\r\n"
+                 "Content-Length: %"PRId64"\r\n"
+                 "Connection: close\r\n\r\n",
+                 start, srv->size - 1, srv->size, srv->size - start);
+    } else {
+        snprintf(head, sizeof(head),
+                 "HTTP/1.1 200 OK\r\n"
+                 "Content-Length: %"PRId64"\r\n"
+                 "Connection: close\r\n\r\n", srv->size);
+    }
+    // the client closes early when it seeks or cancels; send() fails then
+    if (http_send(conn->fd, head, strlen(head)))
+        http_send(conn->fd, srv->data + start, srv->size - start);
+
+done:
+    close(conn->fd);
+    free(conn);
+    pthread_mutex_lock(&srv->lock);
+    if (--srv->connections == 0)
+        pthread_cond_signal(&srv->idle);
+    pthread_mutex_unlock(&srv->lock);
+    return NULL;
+}
+
+static void *http_accept_thread(void *arg)
+{
+    struct http_server *srv = arg;
+    while (1) {
+        int fd = accept(srv->fd, NULL, NULL);
+        if (fd < 0)
+            break; // http_server_stop() shut the socket down
+        struct http_conn *conn = malloc(sizeof(*conn));
+        *conn = (struct http_conn){srv, fd};
+        pthread_mutex_lock(&srv->lock);
+        srv->connections++;
+        pthread_mutex_unlock(&srv->lock);
+        pthread_t thread;
+        if (pthread_create(&thread, NULL, http_conn_thread, conn)) {
+            close(fd);
+            free(conn);
+            pthread_mutex_lock(&srv->lock);
+            srv->connections--;
+            pthread_mutex_unlock(&srv->lock);
+            continue;
+        }
+        pthread_detach(thread);
+    }
+    return NULL;
+}
+
+// Returns false if the server couldn't be started.
+static bool http_server_start(struct http_server *srv, const unsigned char *data,
+                              int64_t size, enum http_range_mode mode)
+{
+    *srv = (struct http_server){ .data = data, .size = size, .mode = mode };
+    pthread_mutex_init(&srv->lock, NULL);
+    pthread_cond_init(&srv->idle, NULL);
+    srv->fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (srv->fd < 0)
+        return false;
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+        .sin_port = 0,
+    };
+    socklen_t addr_len = sizeof(addr);
+    if (bind(srv->fd, (struct sockaddr *)&addr, sizeof(addr)) ||
+        listen(srv->fd, 64) ||
+        getsockname(srv->fd, (struct sockaddr *)&addr, &addr_len) ||
+        pthread_create(&srv->thread, NULL, http_accept_thread, srv))
+    {
+        close(srv->fd);
+        return false;
+    }
+    srv->port = ntohs(addr.sin_port);
+    return true;
+}
+
+// Waits for connection threads, so the clients must have closed their
+// connections before.
+static void http_server_stop(struct http_server *srv)
+{
+    shutdown(srv->fd, SHUT_RDWR);
+    close(srv->fd);
+    pthread_join(srv->thread, NULL);
+    pthread_mutex_lock(&srv->lock);
+    while (srv->connections > 0)
+        pthread_cond_wait(&srv->idle, &srv->lock);
+    pthread_mutex_unlock(&srv->lock);
+    pthread_cond_destroy(&srv->idle);
+    pthread_mutex_destroy(&srv->lock);
+}
+
+#endif
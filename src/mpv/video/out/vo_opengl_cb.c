@@ -21,6 +21,7 @@
 #include "sub/osd.h"
 
 #include "common/global.h"
+#include "osdep/timer.h"
 #include "player/client.h"
 
 #include "gl_common.h"
@@ -39,6 +40,18 @@
 #define FRAME_DROP_POP      0 // drop the oldest frame in queue
 #define FRAME_DROP_CLEAR    1 // drop all frames in queue
 
+#define FRAME_QUEUE_MAX     100 // upper limit of frame-queue-size
+
+// adaptive queue depth
+#define ADAPT_WINDOW        16  // frames to average render interval/jitter
+#define ADAPT_GROW_WAIT     30  // frames to wait after depth has changed
+#define ADAPT_SHRINK_WAIT   300 // stable frames before depth is reduced
+
+struct frame_queue_entry {
+    struct mp_image *mpi;
+    int64_t queued;             // mp_time_us() at flip_page()
+};
+
 struct vo_priv {
     struct vo *vo;
 
@@ -49,6 +62,8 @@ struct vo_priv {
     struct gl_video_opts *renderer_opts;
     int frame_queue_size;
     int frame_drop_mode;
+    int frame_queue_adaptive;
+    int frame_drop_late;
 };
 
 struct mpv_opengl_cb_context {
@@ -62,9 +77,21 @@ struct mpv_opengl_cb_context {
     mpv_opengl_cb_update_fn update_cb;
     void *update_cb_ctx;
     struct mp_image *waiting_frame;
-    struct mp_image **frame_queue;
-    struct frame_timing last_timing;
+    struct frame_queue_entry frame_queue[FRAME_QUEUE_MAX];
+    int frame_queue_head;
     int queued_frames;
+    struct frame_timing last_timing;
+    // queue options in effect; changed by render thread only
+    int queue_size;
+    int queue_depth;            // <= queue_size if adaptive
+    int drop_mode;
+    bool queue_adaptive;
+    bool drop_late;
+    // render timing for adaptive depth
+    int64_t last_render;
+    double render_interval, render_jitter;
+    int adapt_frames;
+    struct mpv_opengl_cb_frame_stats stats;
     struct mp_image_params img_params;
     bool reconfigured;
     struct mp_rect wnd;
@@ -99,12 +126,21 @@ static void update(struct vo_priv *p);
 
 // all queue manipulation functions shold be called under locked state
 
+static struct frame_queue_entry *frame_queue_at(struct mpv_opengl_cb_context *ctx,
+                                                int i)
+{
+    return &ctx->frame_queue[(ctx->frame_queue_head + i) % FRAME_QUEUE_MAX];
+}
+
 static struct mp_image *frame_queue_pop(struct mpv_opengl_cb_context *ctx)
 {
     if (ctx->queued_frames == 0)
         return NULL;
-    struct mp_image *ret = ctx->frame_queue[0];
-    MP_TARRAY_REMOVE_AT(ctx->frame_queue, ctx->queued_frames, 0);
+    struct frame_queue_entry *e = frame_queue_at(ctx, 0);
+    struct mp_image *ret = e->mpi;
+    e->mpi = NULL;
+    ctx->frame_queue_head = (ctx->frame_queue_head + 1) % FRAME_QUEUE_MAX;
+    ctx->queued_frames--;
     return ret;
 }
 
@@ -120,11 +156,9 @@ static void frame_queue_drop(struct mpv_opengl_cb_context *ctx)
 
 static void frame_queue_clear(struct mpv_opengl_cb_context *ctx)
 {
-    for (int i = 0; i < ctx->queued_frames; i++)
-        talloc_free(ctx->frame_queue[i]);
-    talloc_free(ctx->frame_queue);
-    ctx->frame_queue = NULL;
-    ctx->queued_frames = 0;
+    while (ctx->queued_frames > 0)
+        talloc_free(frame_queue_pop(ctx));
+    ctx->frame_queue_head = 0;
 }
 
 static void frame_queue_drop_all(struct mpv_opengl_cb_context *ctx)
@@ -137,13 +171,89 @@ static void frame_queue_drop_all(struct mpv_opengl_cb_context *ctx)
 
 static void frame_queue_push(struct mpv_opengl_cb_context *ctx, struct mp_image *mpi)
 {
-    MP_TARRAY_APPEND(ctx, ctx->frame_queue, ctx->queued_frames, mpi);
+    assert(ctx->queued_frames < FRAME_QUEUE_MAX);
+    struct frame_queue_entry *e = frame_queue_at(ctx, ctx->queued_frames);
+    e->mpi = mpi;
+    e->queued = mp_time_us();
+    ctx->queued_frames++;
 }
 
 static void frame_queue_shrink(struct mpv_opengl_cb_context *ctx, int size)
 {
-    while (ctx->queued_frames > size)
+    while (ctx->queued_frames > size) {
+        frame_queue_drop(ctx);
+        ctx->stats.dropped_full++;
+    }
+}
+
+// Drop frames which have been superseded by a newer frame for longer than one
+// render interval. Showing them would only delay the frames behind them.
+static void frame_queue_drop_late(struct mpv_opengl_cb_context *ctx, int64_t now)
+{
+    int64_t threshold = MPMAX(ctx->render_interval, 1000);
+    while (ctx->queued_frames > 1 &&
+           frame_queue_at(ctx, 1)->queued + threshold <= now)
+    {
         frame_queue_drop(ctx);
+        ctx->stats.dropped_late++;
+    }
+}
+
+// Measure interval and jitter of render calls. If adaptive, adjust the queue
+// depth to the jitter: deeper queue absorbs irregular rendering, shallower
+// queue lowers latency.
+static void frame_queue_adapt(struct mpv_opengl_cb_context *ctx, int64_t now)
+{
+    int64_t last = ctx->last_render;
+    ctx->last_render = now;
+    double interval = now - last;
+    // paused or just started: restart measurement
+    if (last <= 0 || interval > 1e6 ||
+        (ctx->render_interval > 0 && interval > ctx->render_interval * 10))
+    {
+        ctx->render_interval = ctx->render_jitter = 0;
+        ctx->adapt_frames = 0;
+        return;
+    }
+    if (ctx->render_interval <= 0)
+        ctx->render_interval = interval;
+    double dev = fabs(interval - ctx->render_interval);
+    ctx->render_interval += (interval - ctx->render_interval) / ADAPT_WINDOW;
+    ctx->render_jitter += (dev - ctx->render_jitter) / ADAPT_WINDOW;
+    ctx->adapt_frames++;
+    if (!ctx->queue_adaptive)
+        return;
+
+    int depth = ctx->queue_depth;
+    if (ctx->render_jitter > ctx->render_interval * 0.25) {
+        if (ctx->adapt_frames >= ADAPT_GROW_WAIT)
+            depth++;
+    } else if (ctx->render_jitter < ctx->render_interval * 0.1) {
+        if (ctx->adapt_frames >= ADAPT_SHRINK_WAIT)
+            depth--;
+    } else {
+        ctx->adapt_frames = MPMIN(ctx->adapt_frames, ADAPT_GROW_WAIT);
+    }
+    depth = MPCLAMP(depth, 1, ctx->queue_size);
+    if (depth != ctx->queue_depth) {
+        MP_VERBOSE(ctx, "Frame queue depth: %d -> %d (jitter %.1f/%.1f ms)\n",
+                   ctx->queue_depth, depth, ctx->render_jitter / 1e3,
+                   ctx->render_interval / 1e3);
+        ctx->queue_depth = depth;
+        ctx->adapt_frames = 0;
+    }
+}
+
+static void frame_queue_set_options(struct mpv_opengl_cb_context *ctx,
+                                    struct vo_priv *opts)
+{
+    ctx->queue_size = MPCLAMP(opts->frame_queue_size, 1, FRAME_QUEUE_MAX);
+    ctx->drop_mode = opts->frame_drop_mode;
+    ctx->queue_adaptive = opts->frame_queue_adaptive;
+    ctx->drop_late = opts->frame_drop_late;
+    if (!ctx->queue_adaptive || ctx->queue_depth < 1)
+        ctx->queue_depth = ctx->queue_size;
+    ctx->queue_depth = MPMIN(ctx->queue_depth, ctx->queue_size);
 }
 
 static void forget_frames(struct mpv_opengl_cb_context *ctx)
@@ -317,7 +427,8 @@ int mpv_opengl_cb_render(struct mpv_opengl_cb_context *ctx, int fbo, int vp[4])
             gl_video_set_options(ctx->renderer, opts->renderer_opts);
             ctx->gl->debug_context = opts->use_gl_debug;
             gl_video_set_debug(ctx->renderer, opts->use_gl_debug);
-            frame_queue_shrink(ctx, opts->frame_queue_size);
+            frame_queue_set_options(ctx, opts);
+            frame_queue_shrink(ctx, ctx->queue_depth);
         }
         if (ctx->reconfigured || ctx->reset) {
             p->ctx->last_timing.next_vsync = 0;
@@ -336,6 +447,12 @@ int mpv_opengl_cb_render(struct mpv_opengl_cb_context *ctx, int fbo, int vp[4])
     ctx->eq_changed = false;
     ctx->eq = *eq;
 
+    if (ctx->queued_frames > 0) {
+        int64_t now = mp_time_us();
+        frame_queue_adapt(ctx, now);
+        if (ctx->drop_late && ctx->render_interval > 0)
+            frame_queue_drop_late(ctx, now);
+    }
     struct mp_image *mpi = frame_queue_pop(ctx);
 
     pthread_mutex_unlock(&ctx->lock);
@@ -368,6 +485,18 @@ int mpv_opengl_cb_render(struct mpv_opengl_cb_context *ctx, int fbo, int vp[4])
     return left;
 }
 
+int mpv_opengl_cb_get_frame_stats(struct mpv_opengl_cb_context *ctx,
+                                  struct mpv_opengl_cb_frame_stats *stats)
+{
+    pthread_mutex_lock(&ctx->lock);
+    *stats = ctx->stats;
+    stats->queue_depth = ctx->queue_depth;
+    stats->queued_frames = ctx->queued_frames;
+    stats->render_jitter = ctx->render_jitter / 1e3;
+    pthread_mutex_unlock(&ctx->lock);
+    return 0;
+}
+
 static void draw_image(struct vo *vo, mp_image_t *mpi)
 {
     struct vo_priv *p = vo->priv;
@@ -390,11 +519,14 @@ static void flip_page(struct vo *vo)
     struct vo_priv *p = vo->priv;
 
     pthread_mutex_lock(&p->ctx->lock);
-    if (p->ctx->queued_frames >= p->frame_queue_size) {
-        if (p->frame_drop_mode == FRAME_DROP_CLEAR)
-            frame_queue_drop_all(p->ctx);
-        else // FRAME_DROP_POP mode
-            frame_queue_shrink(p->ctx, p->frame_queue_size - 1);
+    struct mpv_opengl_cb_context *ctx = p->ctx;
+    if (ctx->queued_frames >= ctx->queue_depth) {
+        if (ctx->drop_mode == FRAME_DROP_CLEAR) {
+            ctx->stats.dropped_full += ctx->queued_frames;
+            frame_queue_drop_all(ctx);
+        } else { // FRAME_DROP_POP mode
+            frame_queue_shrink(ctx, ctx->queue_depth - 1);
+        }
     }
     frame_queue_push(p->ctx, p->ctx->waiting_frame);
     p->ctx->waiting_frame = NULL;
@@ -435,6 +567,8 @@ static const struct m_option change_opts[] = {
     OPT_CHOICE("frame-drop-mode", frame_drop_mode, 0,
                ({"pop", FRAME_DROP_POP},
                 {"clear", FRAME_DROP_CLEAR})),
+    OPT_FLAG("frame-queue-adaptive", frame_queue_adaptive, 0),
+    OPT_FLAG("frame-drop-late", frame_drop_late, 0),
     OPT_SUBSTRUCT("", renderer_opts, gl_video_conf, 0),
     {0}
 };
@@ -555,6 +689,9 @@ static int preinit(struct vo *vo)
     p->ctx->reconfigured = true;
     assert(vo->osd == p->ctx->osd);
     copy_vo_opts(vo);
+    p->ctx->queue_depth = 0;
+    frame_queue_set_options(p->ctx, p);
+    p->ctx->stats = (struct mpv_opengl_cb_frame_stats){0};
     pthread_mutex_unlock(&p->ctx->lock);
 
     return 0;
@@ -567,6 +704,8 @@ static const struct m_option options[] = {
     OPT_CHOICE("frame-drop-mode", frame_drop_mode, 0,
                ({"pop", FRAME_DROP_POP},
                 {"clear", FRAME_DROP_CLEAR})),
+    OPT_FLAG("frame-queue-adaptive", frame_queue_adaptive, 0),
+    OPT_FLAG("frame-drop-late", frame_drop_late, 0),
     OPT_SUBSTRUCT("", renderer_opts, gl_video_conf, 0),
     {0},
 };